@@ -6,44 +6,119 @@
 
  ARENA MEMORY ALLOCATOR
 
- 2021.03.20
+ Memory is obtained from OS by chunks (anonymous mappings, optionally backed by huge pages);
+ pages are zero and touched lazily, so large capacity costs nothing until used. When current
+ chunk is exhausted the next one, twice larger, is chained. Released blocks of small size are
+ kept in free lists by size class and reused by subsequent allocations of the same size.
+
+ 2021.03.24
 ________________________________________________________________________________________________________________________________
                                                                                                                               */
 #ifndef ARENA_H_INCLUDED
 #define ARENA_H_INCLUDED
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 
+#include <algorithm>
 #include <memory>
 #include <span>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace CoreAGI {
 
   class Arena {
 
-    size_t   CAPACITY;  // :bytes
-    uint8_t* SPACE;
-    uint8_t* VACANT;
-    size_t   AVAILABLE;
+    struct Chunk {
+      Chunk* prev; // :previously allocated chunk or nullptr
+      size_t size; // :bytes including this header
+    };
+
+    static constexpr size_t GRAIN  {           8 }; // :allocation granularity, bytes; not less than pointer size
+    static constexpr size_t CLASSES{         256 }; // :free lists for blocks of GRAIN..GRAIN*(CLASSES-1) bytes
+    static constexpr size_t HUGE   { 2*1024*1024 }; // :huge page size
+    static constexpr size_t LARGEST{   256 << 20 }; // :chunk growth by doubling stops here
+
+    static_assert( GRAIN >= sizeof( void* ) );
+
+    size_t   CAPACITY;        // :bytes in all chunks
+    size_t   OCCUPIED;        // :bytes allocated and not recycled
+    Chunk*   CHUNK;           // :current chunk
+    uint8_t* VACANT;          // :first vacant byte of the current chunk
+    size_t   AVAILABLE;       // :vacant bytes in the current chunk
+    uint8_t  FILLER;
+    bool     HUGEPAGES;
+    void*    FREE[ CLASSES ]; // :heads of free lists; next block address is stored in the block itself
+
+    Chunk* chunk( size_t size, Chunk* prev ){
+      const size_t page{ HUGEPAGES ? HUGE : size_t( sysconf( _SC_PAGESIZE ) ) };
+      size = ( size + page - 1 )/page*page;
+      void* m{ mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) };
+      if( m == MAP_FAILED ){
+        printf( "\n\n [Arena.chunk] FATAL ERROR: can`t allocate %lu Bytes\n\n", size );
+        fflush( stdout );
+        assert( false );
+        return nullptr;
+      }
+#if defined( MADV_HUGEPAGE )
+      if( HUGEPAGES ) madvise( m, size, MADV_HUGEPAGE );
+#endif
+      if( FILLER ) memset( m, FILLER, size );
+      Chunk* c{ static_cast< Chunk* >( m ) };
+      c->prev    = prev;
+      c->size    = size;
+      CAPACITY  += size;
+      CHUNK      = c;
+      VACANT     = reinterpret_cast< uint8_t* >( c + 1 );
+      AVAILABLE  = size - sizeof( Chunk );
+      return c;
+    }
+
+    static size_t rounded( size_t bytes ){ return ( bytes + GRAIN - 1 )/GRAIN*GRAIN; }
 
   public:
 
-    Arena( unsigned capacity /* bytes */, uint8_t filler = 0 ):
-      CAPACITY { capacity                     },
-      SPACE    { (uint8_t*)malloc( capacity ) },
-      VACANT   { SPACE                        },
-      AVAILABLE{ capacity                     }
+    Arena( size_t capacity /* bytes of the first chunk */, uint8_t filler = 0, bool hugepages = false ):
+      CAPACITY { 0         },
+      OCCUPIED { 0         },
+      CHUNK    { nullptr   },
+      VACANT   { nullptr   },
+      AVAILABLE{ 0         },
+      FILLER   { filler    },
+      HUGEPAGES{ hugepages },
+      FREE     {           }
     {
-      assert( SPACE );
-      memset( SPACE, filler, CAPACITY );
+      chunk( std::max( capacity, sizeof( Chunk ) + GRAIN ), nullptr );
     }
 
     Arena( const Arena& ) = delete;
     Arena& operator= ( const Arena& ) = delete;
 
     void reset( uint8_t filler = 0 ){
-      VACANT    = SPACE;
-      AVAILABLE = CAPACITY;
-      memset( SPACE, filler, CAPACITY );
+                                                                                                                              /*
+      Release all chunks except the first one; its pages are returned to OS (and will be zero
+      when touched again) or filled by `filler`:
+                                                                                                                              */
+      FILLER = filler;
+      Chunk* first{ CHUNK };
+      while( first->prev ){
+        Chunk* c{ first };
+        first     = first->prev;
+        CAPACITY -= c->size;
+        munmap( c, c->size );
+      }
+      const size_t size{ first->size };
+      if( filler ) memset( first, filler, size ); else madvise( first, size, MADV_DONTNEED );
+      first->prev = nullptr;
+      first->size = size;
+      CHUNK       = first;
+      VACANT      = reinterpret_cast< uint8_t* >( first + 1 );
+      AVAILABLE   = size - sizeof( Chunk );
+      OCCUPIED    = 0;
+      for( auto& head: FREE ) head = nullptr;
     }
 
     bool dump( const char* path = "arena.dump" ) const {
@@ -52,61 +127,98 @@ namespace CoreAGI {
                                                                                                                                 */
       FILE* out = fopen( path, "w" );
       if( out == nullptr ) return false;
-      fprintf( out, " Arena capacity: %lu; occupied: %lu; vacant: %lu.\n", CAPACITY, CAPACITY - AVAILABLE, AVAILABLE );
+      fprintf( out, " Arena capacity: %lu; occupied: %lu; vacant: %lu.\n", CAPACITY, OCCUPIED, AVAILABLE );
       constexpr size_t COL_NUM{ 32 };
-      const     size_t totalRows{ 1 + CAPACITY / COL_NUM  };
-      for( size_t row = 0; row < totalRows; row++ ){
-        fprintf( out, "\n %10lu ", row*COL_NUM );
-        for( size_t col = 0; col < COL_NUM; col++ ){
-          const size_t i{ row*COL_NUM + col };
-          if( i < CAPACITY ) fprintf( out, " %02x", SPACE[i] ); else fprintf( out, "   " );
+      for( const Chunk* c = CHUNK; c; c = c->prev ){
+        const uint8_t* SPACE{ reinterpret_cast< const uint8_t* >( c + 1 ) };
+        const size_t   SIZE { c == CHUNK ? size_t( VACANT - SPACE ) : c->size - sizeof( Chunk ) };
+        fprintf( out, "\n Chunk %p: %lu bytes", (const void*)c, SIZE );
+        const size_t totalRows{ 1 + SIZE / COL_NUM };
+        for( size_t row = 0; row < totalRows; row++ ){
+          fprintf( out, "\n %10lu ", row*COL_NUM );
+          for( size_t col = 0; col < COL_NUM; col++ ){
+            const size_t i{ row*COL_NUM + col };
+            if( i < SIZE ) fprintf( out, " %02x", SPACE[i] ); else fprintf( out, "   " );
+          }
         }
+        fprintf( out, "\n" );
       }
-      fprintf( out, "\n" );
       fclose( out );
       return true;
     }
 
-    size_t available() const { return AVAILABLE;            }
-    size_t occupied () const { return CAPACITY - AVAILABLE; }
+    size_t capacity () const { return CAPACITY;  } // :bytes obtained from OS
+    size_t available() const { return AVAILABLE; } // :bytes available without new chunk allocation
+    size_t occupied () const { return OCCUPIED;  } // :bytes in use
 
     template< typename T > T* settle( unsigned length = 1, unsigned alignTo = sizeof( T ) ){
+                                                                                                                              /*
+      Allocate uninitialized T[ length ]; recycled block of the same size class is used if any:
+                                                                                                                              */
       assert( length > 0 );
-      unsigned total = length*sizeof( T );
+      const size_t total{ rounded( size_t( length )*sizeof( T ) ) };
+      const size_t k    { total/GRAIN                             };
+      if( k < CLASSES and FREE[k] and reinterpret_cast< uintptr_t >( FREE[k] ) % alignTo == 0 ){
+        void* block{ FREE[k] };
+        FREE[k]   = *static_cast< void** >( block );
+        OCCUPIED += total;
+        return static_cast< T* >( block );
+      }
       T* location{ (T*)std::align( alignTo, total, (void*&)VACANT, AVAILABLE ) };
-      if( location ){
-        VACANT    += total;
-        AVAILABLE -= total;
-      } else {
-        printf( "\n\n [Arena.settle] FATAL ERROR: unsufficient available space:" );
-        printf(   "\n   Available: %10lu Bytes", AVAILABLE );
-        printf(   "\n   Requested: %10u Bytes",  total     );
-        printf( "\n\n" );
-        fflush( stdout );
-        assert( false ); // :insufficient memory;
+      if( not location ){
+        const size_t next{ std::min( 2*CHUNK->size, LARGEST ) };
+        chunk( std::max( next, sizeof( Chunk ) + total + alignTo ), CHUNK );
+        location = (T*)std::align( alignTo, total, (void*&)VACANT, AVAILABLE );
+        assert( location );
       }
+      VACANT    += total;
+      AVAILABLE -= total;
+      OCCUPIED  += total;
       return location;
     }
 
-    template< typename T > std::span< T > span( size_t length ){
-      if( length == 0 ) return std::span< T >{};
+    template< typename T > void recycle( T* head, unsigned length = 1 ){
                                                                                                                               /*
-      Allocate T[ length ]:
+      Return block allocated by `settle< T >( length )` for reuse; large blocks are not reused
+      until `reset`:
                                                                                                                               */
-      T* head{ settle< T >( length ) };
+      if( head == nullptr or length == 0 ) return;
+      const size_t total{ rounded( size_t( length )*sizeof( T ) ) };
+      const size_t k    { total/GRAIN                             };
+      OCCUPIED -= total;
+      if( k >= CLASSES ) return;
+      *reinterpret_cast< void** >( head ) = FREE[k];
+      FREE[k] = head;
+    }
+
+    template< typename T > void recycle( std::span< T > s ){ recycle( s.data(), s.size() ); }
+
+    template< typename T > std::span< T > raw( size_t length ){
                                                                                                                               /*
-      Initialize T[]:
+      Allocate uninitialized T[ length ] for the caller that overwrites it anyway:
                                                                                                                               */
-      const T t{};
-      for( unsigned i = 0; i < length; i++ ) head[i] = t;
-      assert( head );
+      static_assert( std::is_trivially_copyable< T >::value );
+      if( length == 0 ) return std::span< T >{};
+      return std::span< T >{ settle< T >( length ), length };
+    }
+
+    template< typename T > std::span< T > span( size_t length ){
                                                                                                                               /*
-      Return std::span that represents T[ length ]:
+      Allocate and value-initialize T[ length ]:
                                                                                                                               */
+      if( length == 0 ) return std::span< T >{};
+      T* head{ settle< T >( length ) };
+      std::uninitialized_value_construct_n( head, length );
       return std::span< T >{ head, length };
     }
 
-   ~Arena(){ free( SPACE ); }
+   ~Arena(){
+      while( CHUNK ){
+        Chunk* c{ CHUNK };
+        CHUNK = c->prev;
+        munmap( c, c->size );
+      }
+    }
 
   };
 
@@ -0,0 +1,256 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Dynamic bitmap with rank/select. Bits are grouped into superblocks of 512 bits
+ (8 words); number of ones is kept for each superblock, so scanning skips empty
+ superblocks at once, and in Fenwick tree over superblocks, so `rank` and `select`
+ take O(log(BITS/512)) steps plus at most 8 popcounts. Update of a bit costs the same.
+ If BITS is DYNAMIC, number of bits is given to constructor and arrays are allocated on heap.
+
+ 2021.04.02
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#ifndef BITMAP_H_INCLUDED
+#define BITMAP_H_INCLUDED
+
+#include <cassert>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <type_traits>
+#include <vector>
+
+#if defined( __BMI2__ )
+  #include <immintrin.h>
+#endif
+
+#include "def.h"
+
+namespace CoreAGI {
+
+  template< unsigned BITS > class Bitmap {
+
+    static constexpr bool     FIXED{ BITS != DYNAMIC }; // :size is known at compile time
+    static constexpr unsigned SPAN { 8               }; // :words per superblock
+
+    static constexpr unsigned words ( unsigned bits ){ return ( bits + 63 )/64;                } // :number of 64-bit words
+    static constexpr unsigned blocks( unsigned bits ){ return ( words( bits ) + SPAN - 1 )/SPAN; } // :number of superblocks
+
+    template< typename T, unsigned N > using Array = std::conditional_t< FIXED, std::array< T, N >, std::vector< T > >;
+
+    const unsigned SIZE;  // :number of bits
+    const unsigned WORDS; // :number of 64-bit words
+    const unsigned BLOCK; // :number of superblocks
+    const unsigned TOP;   // :initial step of Fenwick descent
+
+    Array< uint64_t, words ( BITS )     > word;
+    Array< uint32_t, blocks( BITS )     > block; // :number of ones in the superblock
+    Array< uint32_t, blocks( BITS ) + 1 > tree;  // :Fenwick tree over `block`, 1-based
+    uint32_t                              ones;  // :total number of ones
+
+    void add( unsigned b, int32_t delta ){
+      block[b] += delta;
+      for( unsigned i = b + 1; i <= BLOCK; i += i & -i ) tree[i] += delta;
+      ones += delta;
+    }
+
+    uint32_t prefix( unsigned b ) const { // :number of ones in superblocks [ 0, b )
+      uint32_t sum{ 0 };
+      for( unsigned i = b; i > 0; i -= i & -i ) sum += tree[i];
+      return sum;
+    }
+
+    void recount(){ // :rebuild counters from words
+      std::fill( block.begin(), block.end(), 0 );
+      std::fill( tree.begin(),  tree.end(),  0 );
+      ones = 0;
+      for( unsigned w = 0; w < WORDS; w++ ) block[ w/SPAN ] += unsigned( std::popcount( word[w] ) );
+      for( unsigned b = 0; b < BLOCK; b++ ){
+        ones += block[b];
+        tree[ b + 1 ] += block[b];
+        const unsigned up{ ( b + 1 ) + ( ( b + 1 ) & -( b + 1 ) ) };
+        if( up <= BLOCK ) tree[ up ] += tree[ b + 1 ];
+      }
+    }
+
+    void fill( unsigned from, unsigned to ){ // :set bits [ from, to ) without counters update
+      for( unsigned i = from; i < to; ){
+        const unsigned w{ i/64 };
+        const unsigned k{ std::min( to - w*64, 64u ) };            // :end of the range within the word
+        const uint64_t m{ k == 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << k ) - 1 };
+        word[w] |= m & ( ~uint64_t( 0 ) << ( i % 64 ) );
+        i = w*64 + k;
+      }
+    }
+
+    static unsigned selectInWord( uint64_t w, unsigned k ){ // :position of the k-th (0-based) one of `w`
+#if defined( __BMI2__ )
+      return unsigned( std::countr_zero( _pdep_u64( uint64_t( 1 ) << k, w ) ) );
+#else
+      for( ; k > 0; k-- ) w &= w - 1;
+      return unsigned( std::countr_zero( w ) );
+#endif
+    }
+
+  public:
+
+    Bitmap( unsigned bits = BITS ):
+      SIZE { bits                             },
+      WORDS{ words ( bits )                   },
+      BLOCK{ blocks( bits )                   },
+      TOP  { std::bit_floor( blocks( bits ) ) },
+      word {                                  },
+      block{                                  },
+      tree {                                  },
+      ones { 0                                }
+    {
+      assert( bits > 0 and ( not FIXED or bits == BITS ) );
+      if constexpr( not FIXED ){
+        word .resize( WORDS     );
+        block.resize( BLOCK     );
+        tree .resize( BLOCK + 1 );
+      }
+      clear();
+    }
+
+    unsigned size() const { return SIZE; }
+
+    void clear(){
+      std::fill( word.begin(),  word.end(),  0 );
+      std::fill( block.begin(), block.end(), 0 );
+      std::fill( tree.begin(),  tree.end(),  0 );
+      ones = 0;
+    }
+
+    unsigned count() const { return ones; }
+
+    bool test( unsigned i ) const {
+      assert( i < SIZE );
+      return ( word[ i/64 ] >> ( i % 64 ) ) & 1;
+    }
+
+    void set( unsigned i ){
+      assert( i < SIZE );
+      const uint64_t m{ uint64_t( 1 ) << ( i % 64 ) };
+      if( word[ i/64 ] & m ) return;
+      word[ i/64 ] |= m;
+      add( i/64/SPAN, +1 );
+    }
+
+    void reset( unsigned i ){
+      assert( i < SIZE );
+      const uint64_t m{ uint64_t( 1 ) << ( i % 64 ) };
+      if( not ( word[ i/64 ] & m ) ) return;
+      word[ i/64 ] &= ~m;
+      add( i/64/SPAN, -1 );
+    }
+
+    template< typename F > void assign( F one ){
+                                                                                                                              /*
+      Rebuild all bits: bit `i` is set if `one( i )`; takes O(BITS):
+                                                                                                                              */
+      std::fill( word.begin(), word.end(), 0 );
+      for( unsigned i = 0; i < SIZE; i++ ) if( one( i ) ) word[ i/64 ] |= uint64_t( 1 ) << ( i % 64 );
+      recount();
+    }
+
+    void assign( unsigned from, unsigned to ){
+                                                                                                                              /*
+      Rebuild all bits: only [ from, to ) are set; range wraps around if from > to; takes O(BITS/64):
+                                                                                                                              */
+      assert( from <= SIZE and to <= SIZE );
+      std::fill( word.begin(), word.end(), 0 );
+      if( from <= to ) fill( from, to ); else { fill( from, SIZE ); fill( 0, to ); }
+      recount();
+    }
+
+    unsigned rank( unsigned i ) const {
+                                                                                                                              /*
+      Number of ones in [ 0, i ):
+                                                                                                                              */
+      assert( i <= SIZE );
+      if( i == SIZE ) return ones;
+      const unsigned w{ i/64 };
+      unsigned r{ prefix( w/SPAN ) };
+      for( unsigned k = w/SPAN*SPAN; k < w; k++ ) r += unsigned( std::popcount( word[k] ) );
+      return r + unsigned( std::popcount( word[w] & ( ( uint64_t( 1 ) << ( i % 64 ) ) - 1 ) ) );
+    }
+
+    unsigned select( unsigned k ) const {
+                                                                                                                              /*
+      Position of the k-th (0-based) one; k < count():
+                                                                                                                              */
+      assert( k < ones );
+      unsigned b{ 0 };
+      for( unsigned step = TOP; step > 0; step >>= 1 ){ // :Fenwick descent to the superblock
+        if( b + step <= BLOCK and tree[ b + step ] <= k ){
+          b += step;
+          k -= tree[b];
+        }
+      }
+      for( unsigned w = b*SPAN; ; w++ ){
+        assert( w < WORDS );
+        const unsigned c( std::popcount( word[w] ) );
+        if( k < c ) return w*64 + selectInWord( word[w], k );
+        k -= c;
+      }
+    }
+
+    unsigned next( unsigned i ) const {
+                                                                                                                              /*
+      Position of the first one in [ i, BITS ) or BITS; empty superblocks are skipped at once:
+                                                                                                                              */
+      if( i >= SIZE ) return SIZE;
+      unsigned w{ i/64 };
+      uint64_t x{ word[w] & ( ~uint64_t( 0 ) << ( i % 64 ) ) };
+      while( x == 0 ){
+        if( ++w >= WORDS ) return SIZE;
+        if( w % SPAN == 0 ) while( block[ w/SPAN ] == 0 ){ w += SPAN; if( w >= WORDS ) return SIZE; }
+        x = word[w];
+      }
+      return w*64 + unsigned( std::countr_zero( x ) );
+    }
+
+    int64_t prev( int64_t i ) const {
+                                                                                                                              /*
+      Position of the last one in [ 0, i ] or -1:
+                                                                                                                              */
+      if( i < 0 ) return -1;
+      assert( i < SIZE );
+      int64_t  w{ i/64 };
+      uint64_t x{ word[w] & ( ~uint64_t( 0 ) >> ( 63 - i % 64 ) ) };
+      while( x == 0 ){
+        if( --w < 0 ) return -1;
+        if( w % SPAN == SPAN - 1 ) while( block[ w/SPAN ] == 0 ){ w -= SPAN; if( w < 0 ) return -1; }
+        x = word[w];
+      }
+      return w*64 + 63 - std::countl_zero( x );
+    }
+
+    int64_t prevZero( int64_t i ) const {
+                                                                                                                              /*
+      Position of the last zero in [ 0, i ] or -1:
+                                                                                                                              */
+      if( i < 0 ) return -1;
+      assert( i < SIZE );
+      int64_t  w{ i/64 };
+      uint64_t x{ ~word[w] & ( ~uint64_t( 0 ) >> ( 63 - i % 64 ) ) };
+      while( x == 0 ){
+        if( --w < 0 ) return -1;
+        x = ~word[w];
+      }
+      return w*64 + 63 - std::countl_zero( x );
+    }
+
+    bool none( unsigned from, unsigned to ) const { return next( from ) >= to; } // :no ones in [ from, to )
+
+  };//class Bitmap
+
+}//namespace CoreAGI
+
+#endif // BITMAP_H_INCLUDED
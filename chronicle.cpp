@@ -13,6 +13,14 @@
 
      uni2ascii [options] path-to-file
 
+ USAGE
+
+   chronicle [--capacity=N] [--hugepages] [--snapshot=PATH] [source...]
+
+   Sources are files or "-" for stdin, all files of `txt` directory by default;
+   `--capacity` sets sequence capacity (524288 by default), `--hugepages` backs
+   sequence arrays by huge pages, `--snapshot` saves binary snapshot of the
+   chronicle as PATH and restores it back (no files are written by default).
 
 ________________________________________________________________________________________________________________________________
                                                                                                                               */
@@ -25,12 +33,18 @@ ________________________________________________________________________________
 #include <unordered_set>
 #include <ranges>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "arena.h"
 #include "chronicle.h"
 #include "def.h"
+#include "engine.h"
+#include "input.h"
+#include "pipeline.h"
 #include "random.h"         // :random pattern ID
+#include "store.h"
+#include "text.h"
 #include "timer.h"
 
 using namespace CoreAGI;
@@ -38,92 +52,43 @@ using namespace CoreAGI;
 namespace fs = std::filesystem;
 
 
-struct View{
-                                                                                                                              /*
-  If `tail` == 0 then pattern represents atomic entity ~ char
-  and `head` value must be in [ 0..255 ]:
-                                                                                                                              */
-  Identity head;
-  Identity tail;
-
-  View(): head{ CoreAGI::NIHIL }, tail{ CoreAGI::NIHIL }{}
-
-  View( const Identity& h, const Identity& t ): head{ h }, tail{ t }{
-    assert( head != CoreAGI::NIHIL );
-    assert( tail != CoreAGI::NIHIL );
-  }
-
-  View& operator= ( const View& P ){ head = P.head; tail = P.tail; return *this; }
-
-  bool operator== ( const View& P ) const { return head == P.head and tail == P.tail; }
-
-};//View
-
-
 using Atom = char;
 
 
-struct Pattern {
-
-  std::span< Identity > seq;
-
-  Pattern( std::span< Identity > seq ): seq{ seq }{}
-  Pattern(                           ): seq{     }{}
-
-  bool operator== ( const Pattern& P ) const {
-    if( seq.size() != P.seq.size() ) return false;
-    for( unsigned i = 0; i < seq.size(); i++ ) if( seq[i] != P.seq[i] ) return false;
-    return true;
-  }
-
-};//struct Pattern
-
-using Key = CoreAGI::Key;   // : see def.h
-
-namespace std {
-                                                                                                                              /*
-  Hash function for View:
-                                                                                                                              */
-  template<> struct hash< View > {
-    std::size_t operator()( const View& P ) const { return combination( P.head, P.tail ); }
-  };
-
-  template<> struct hash< Pattern > {
-    std::size_t operator()( const Pattern& P ) const {
-      std::size_t result{ 0 };
-      for( const auto& elem: P.seq ) result ^= elem;
-      return result;
-    }
-  };
-
-}//namespace std
-
-
-int main(){
-
-  constexpr unsigned CAPACITY        { 512*1024 }; // :sequence capacity
-  constexpr unsigned STORAGE_CAPACITY{ 256*1024 }; // :pattern storage bytes
-  constexpr size_t   UINT24MASK      { 0xFFFFFF };
-  constexpr char     CR              { '\r'     };
-  constexpr char     SPC             { ' '      };
+int main( int argc, char* argv[] ){
+
+            unsigned CAPACITY        {  512*1024 }; // :sequence capacity; `--capacity=N` option
+            bool     HUGEPAGES       {     false }; // :sequence arrays backed by huge pages; `--hugepages` option
+  const char*        SNAPSHOT        {   nullptr }; // :path of the snapshot round trip; `--snapshot=PATH` option
+  constexpr unsigned STORAGE_CAPACITY{ 1024*1024 }; // :initial pattern storage bytes (grows on demand)
+  constexpr unsigned SLICE           {        64 }; // :incremental compaction budget per symbol; 0 means stop-the-world compaction
+  constexpr unsigned GAP             {  16*1024 }; // :number of holes that triggers compaction
+  constexpr size_t   BLOCK           {  64*1024 }; // :input block size, bytes
+  constexpr size_t   CHUNK           {        16 }; // :symbols included into chronicle per call
+  constexpr size_t   UINT24MASK      {  0xFFFFFF };
+  constexpr bool     WIDE            { false     }; // :`Wide` chronicle: any 32-bit ID, 64-bit locations
+  constexpr char     SPC             { ' '       };
+  constexpr bool     PIPELINE        { true      }; // :input is read and normalized by separate thread
+  constexpr unsigned DEPTH           {         8 }; // :pipeline batches in flight
+  constexpr unsigned SHARDS          {         1 }; // :>1 means sources are distributed over shards of `ChronicleEngine`
                                                                                                                               /*
   Simplistic semantic storage for patterns:
                                                                                                                               */
   Arena arena{ STORAGE_CAPACITY };                            // :storage for pattern` objects
 
   Identity ATOM[ 256 ];                                              // :symbol -> atom ID
-  for( unsigned i = 0; i < 156; i++ ) ATOM[i] = CoreAGI::NIHIL;      // :make empty map
+  for( unsigned i = 0; i < 256; i++ ) ATOM[i] = CoreAGI::NIHIL;      // :make empty map
   std::unordered_map< Identity, Atom    > SYMBOL;                    // :atom ID -> symbol
   std::unordered_set< Identity          > unconnectable;             // :kind of atoms
-  std::unordered_map< Identity, Pattern > PATTERN;                   // :pattern ID     -> Pattern` object
-  std::unordered_map< View,     Identity> DICTIONARY;                // :pattern view   -> pattern` ID
-  std::unordered_map< Pattern,  Identity> GLOSSARY;                  // :pattern object -> pattern` ID
+  std::conditional_t< ( SHARDS > 1 ), SharedPatternStore, PatternStore >
+                                          store{ arena };            // :atoms, patterns, views and glossary
                                                                                                                               /*
   Check if ID is presented:
                                                                                                                               */
-  auto atomic    = [&]( const Identity& id )->bool{ return SYMBOL .find( id ) != SYMBOL .end(); };
-  auto composite = [&]( const Identity& id )->bool{ return PATTERN.find( id ) != PATTERN.end(); };
-  auto exist     = [&]( const Identity& id )->bool{ return composite( id ) or atomic( id );     };
+  auto atomic = [&]( const Identity& id )->bool{ return SYMBOL.find( id ) != SYMBOL.end(); };
+  auto exist  = [&]( const Identity& id )->bool{ return store.contains( id );               };
+
+  auto length = [&]( const Identity& id )->unsigned{ return store.length( id ); };
 
   auto expo = [&]( const Identity* sequence, unsigned length ){
     printf( "%c", '`' );
@@ -135,35 +100,14 @@ int main(){
     printf( "%c", '`' );  fflush( stdout );
   };
 
-  auto appendAtom = [&]( Identity* out, /*mod*/unsigned* lim, /*mod*/unsigned* len, const Identity& atom )->Identity*{
-    assert( *lim > 1       );
-    *out = atom;
-    (*len)++;
-    (*lim)--;
-    return out + 1;
-  };
-
-  auto appendPattern = [&]( Identity* out, /*mod*/unsigned* lim, /*mod*/unsigned* len, const Pattern& pattern )->Identity*{
-    assert( *lim > pattern.seq.size() );
-    unsigned* loc = out;
-    for( const auto& atom: pattern.seq ) loc = appendAtom( loc, lim, len, atom );
-    return loc;
-  };
-
-  auto unfold = [&]( Identity* seq, /*mod*/unsigned* lim, /*mod*/unsigned* len, const Identity& id )->Identity*{
-                                                                                                                              /*
-    Unfold pattern sequence into `seq` or place atom ID into `seq`; returns number of added elements:
-                                                                                                                              */
-    if( atomic( id ) ) return appendAtom( seq, lim, len, id );
-    assert( composite( id ) );
-    return appendPattern( seq, lim, len, PATTERN.at( id ) );
-  };
                                                                                                                               /*
   Generation unique ID:
                                                                                                                               */
+  auto randomId = [&]()->Identity{ return Identity( randomNumber() & ( WIDE ? 0xFFFFFFFF : UINT24MASK ) ); };
+
   auto uniqueId = [&]()->Identity{
     Identity id{ CoreAGI::NIHIL };
-    do{ id = Identity( randomNumber() & UINT24MASK ); } while( exist( id ) );
+    do{ id = randomId(); } while( id == CoreAGI::NIHIL or exist( id ) );
     return id;
   };
 
@@ -173,6 +117,7 @@ int main(){
     const Identity id{ uniqueId() };
     SYMBOL[ id ] = symbol;
     ATOM  [ i  ] = id;
+    store.atom( id );
     return id;
   };
 
@@ -182,53 +127,10 @@ int main(){
     assert( exist( head )          );
     assert( exist( tail )          );
                                                                                                                               /*
-    Compose pattern sequence in `seq` array with actual length `len`:
-                                                                                                                              */
-    constexpr unsigned CAPACITY{ 256 };
-    Identity  seq[ CAPACITY ];              // :pattern` sequence
-    Identity* loc{ seq      };              // :pointer to first vacant position
-    unsigned  lim{ CAPACITY };              // :how mant symbols can be added
-    unsigned  len{ 0        };              // :pattern` length
-    loc = unfold( loc, &lim, &len, head );
-    loc = unfold( loc, &lim, &len, tail );
-    assert( len >= 2 );
-                                                                                                                              /*
-    Make Pattern instance with content stored in the `seq`:
-                                                                                                                              */
-    Pattern P{ std::span< Identity >( seq, len ) };
-                                                                                                                              /*
-    Check if such pattern already presented:
-                                                                                                                              */
-    Identity id{ CoreAGI::NIHIL };
-    const auto& it = GLOSSARY.find( P );
-    if( it != GLOSSARY.end() ){
-                                                                                                                              /*
-      Such petter already presented, so make View only and store it:
-                                                                                                                              */
-      id = it->second;
-      DICTIONARY[ View( head, tail ) ] = id;
-    } else {
-                                                                                                                              /*
-      Make random pattern` ID:
-                                                                                                                              */
-      id = uniqueId();
-                                                                                                                              /*
-      Allocate pattern sequence:
+    Known pattern with the same sequence or new one with random ID; view ( head, tail ) is stored.
+    Store skips IDs in use itself (under its lock if shared):
                                                                                                                               */
-      Pattern Q{ arena.span< Identity >( len ) };
-      assert( Q.seq.size() == len );
-                                                                                                                              /*
-      Copy pattern sequence:
-                                                                                                                              */
-      memcpy( Q.seq.data(), seq, sizeof( Identity )*len );
-                                                                                                                              /*
-      Store pattern and view:
-                                                                                                                              */
-      DICTIONARY[ View( head, tail ) ] = id;
-      GLOSSARY  [ Q                  ] = id;
-      PATTERN   [ id                 ] = Q;
-    }
-    return id;
+    return store.make( head, tail, randomId );
   };
                                                                                                                               /*
   Functions that provided external functionality for the Chronicle object:
@@ -237,15 +139,10 @@ int main(){
     if( atomic( id ) ){
       return std::string( 1, char( SYMBOL.at( id ) ) );
     }
-    char P[ 256 ];
-    unsigned i{ 0 };
-    assert( PATTERN.contains( id ) );
-    for( const Identity& elem: PATTERN.at( id ).seq ){
-      P[i++] = SYMBOL.at( elem );
-      if( i > 254 ) break;
-    }
-    P[i] = '\0';
-    return std::string( P );
+    std::string P;
+    P.reserve( length( id ) );
+    store.unfold( id, [&]( const Identity& elem ){ P += SYMBOL.at( elem ); } );
+    return P;
   };
 
   auto sticky = [&]( const Identity& head, const Identity& tail )->bool {
@@ -255,35 +152,12 @@ int main(){
   };
 
   auto find = [&]( const Identity& head, const Identity& tail )->Identity {
-    const auto& it = DICTIONARY.find( View{ head, tail } );
-    if( it != DICTIONARY.end() ) return it->second;
-                                                                                                                              /*
-    Compose pattern sequence:
-                                                                                                                              */
-    constexpr unsigned CAPACITY{ 256 };
-    Identity  seq[ CAPACITY ];
-    Identity* loc{ seq      };
-    unsigned  lim{ CAPACITY };
-    unsigned  len{ 0        };
-    loc = unfold( loc, &lim, &len, head );
-    loc = unfold( loc, &lim, &len, tail );
-                                                                                                                              /*
-    Make Pattern instance:
-                                                                                                                              */
-    Pattern P{ std::span< Identity >( seq, len ) };
-                                                                                                                              /*
-    Check if such pattern already presented:
-                                                                                                                              */
-    Identity id{ CoreAGI::NIHIL };
-    const auto& itt = GLOSSARY.find( P );
-    if( itt != GLOSSARY.end() ){
+    const Identity id{ store.known( head, tail ) };
+    if( id != CoreAGI::NIHIL ) return id;
                                                                                                                               /*
-      Such petter already presented, so make View only:
+    Check if pattern with the same sequence already presented (then view is stored):
                                                                                                                               */
-      id = itt->second;
-      DICTIONARY[ View( head, tail ) ] = id;
-    }
-    return id;
+    return store.find( head, tail );
   };
                                                                                                                               /*
   Set of special symbols:
@@ -296,6 +170,13 @@ int main(){
   const Identity QUEST{ atom( '?' ) };
   const Identity QUOT1{ atom( '\'') };
   const Identity QUOT2{ atom( '"' ) };
+                                                                                                                              /*
+  All the other symbols that `Text::normalize` can produce; atom map is not changed after that,
+  so the reader thread of the pipeline maps symbols without synchronization:
+                                                                                                                              */
+  for( char c = SPC; c < 127; c++ ){
+    if( ATOM[ unsigned( c ) ] == CoreAGI::NIHIL and Text::normal( c ) == c ) atom( c );
+  }
 
   unconnectable.insert( SPACE );
   unconnectable.insert( DOT   );
@@ -306,74 +187,192 @@ int main(){
   unconnectable.insert( QUOT1 );
   unconnectable.insert( QUOT2 );
 
-  Chronicle< CAPACITY > chronicle( lex, sticky, pattern, find );
+  Hooks hooks{ lex, sticky, pattern, find }; // :static policy, so `Chronicle` calls lambdas directly
+  std::vector< std::string > sources;
+  constexpr const char* SOURCES{ "txt" };
+  for( int i = 1; i < argc; i++ ){
+    const std::string arg{ argv[i] };
+    if     ( arg.starts_with( "--capacity=" ) ) CAPACITY  = unsigned( std::stoul( arg.substr( 11 ) ) );
+    else if( arg == "--hugepages"             ) HUGEPAGES = true;
+    else if( arg.starts_with( "--snapshot=" ) ) SNAPSHOT  = argv[i] + 11;
+    else                                        sources.push_back( arg ); // :explicit sources; "-" means stdin
+  }
+  using Records = std::conditional_t< WIDE, Wide, Narrow >;
+  Chronicle< DYNAMIC, decltype( hooks ), Records > chronicle( hooks, CAPACITY, HUGEPAGES ); // :capacity chosen at run time
+
+  struct Tally {
+    unsigned symbols        { 0   };
+    unsigned compno         { 0   };
+    double   compdt         { 0.0 };  // :total compaction time, microsec
+    double   compmax        { 0.0 };  // :longest compaction slice, microsec
+    unsigned hasContinuation{ 0   };
+  };
 
-  unsigned totalSymbolsProcessed{ 0   };
-  double   dt                   { 0.0 };
-  unsigned compno               { 0   };
-  unsigned hasContinuation      { 0   };
+  Tally  total;
+  double dt{ 0.0 };
 
-  auto process = [&]( const char* path ){
-    printf( "\n\n Process `%s`\n", path );
-    fflush( stdout );
-    FILE* src   { fopen( path, "r" ) };
-    Atom  symbol{ 0                  };
-    Atom  prev  { SPC                };
-    Timer timer;
-    for(;;){
-      if( totalSymbolsProcessed % 10000 == 0 ){
-        printf( "\r Processed %10u symbols", totalSymbolsProcessed );
+  auto consume = [&]( auto& chronicle, Tally& tally, std::span< const Identity > ids ){
+                                                                                                                              /*
+    Include atoms into the chronicle by small chunks, compacting incrementally:
+                                                                                                                              */
+    for( size_t i = 0; i < ids.size(); i += CHUNK ){
+      const std::span< const Identity > chunk{ ids.subspan( i, std::min( CHUNK, ids.size() - i ) ) };
+      tally.hasContinuation += chronicle.incl( chunk );
+      if( SHARDS == 1 and ( tally.symbols + chunk.size() )/10000 != tally.symbols/10000 ){
+        printf( "\r Processed %10u symbols", tally.symbols );
         fflush( stdout );
       }
-      if( ( symbol = (char)fgetc( src ) ) == EOF ) break;
-      if( symbol == CR                                               ) continue;
-      if( symbol >= 127 or symbol < 32 or not std::isprint( symbol ) ) symbol = SPC;
-      if( symbol == SPC and prev == SPC                              ) continue;     // :eliminate multiple spaces
-      symbol = tolower( symbol );                                                    // :convert symbol to lower case
-      totalSymbolsProcessed++;
+      tally.symbols += chunk.size();
+      if( chronicle.compacting() or chronicle.gap() >= GAP ){
+        Timer slice;
+        if( SLICE > 0 ) chronicle.step( SLICE*chunk.size() ); else chronicle.compact();
+        slice.stop();
+        const double t{ slice( Timer::MICROSEC ) };
+        tally.compdt += t;
+        if( t > tally.compmax ) tally.compmax = t;
+        tally.compno++;
+      }
+    }
+  };
+
+  auto read = [&]( const char* path, auto emit ){
                                                                                                                               /*
-      Get ID of the known Atom or make a new atom:
+    Read source by blocks, normalize each block and pass IDs of its atoms to `emit`; atoms are
+    predefined, so only the atom map is used:
                                                                                                                               */
-      Identity id = ATOM[ unsigned( symbol ) ];
-      if( id == 0 ) id = atom( symbol );
-      assert( chronicle.incl( id ) );
-      if( not atomic( chronicle.lastId() ) ) hasContinuation++;
-      prev = symbol;
-      if( chronicle.gap() >= 16*1024 ){ chronicle.compact(); compno++; }
-    }//forever
-    timer.stop();
-    dt += timer( Timer::MICROSEC );
-    fclose( src );
-    printf( "\r Processed %10u symbols", totalSymbolsProcessed );
-    fflush( stdout );
+    Source src( path, BLOCK );
+    if( not src ){ printf( "\n Can`t open `%s`", path ); return; }
+    std::vector< char > text( BLOCK );
+    char prev{ SPC };
+    for(;;){
+      const std::span< const char > raw{ src.next() };
+      if( raw.empty() ) break;
+      const size_t m{ Text::normalize( raw.data(), raw.size(), text.data(), prev ) };
+      if( m > 0 ) emit( std::span< const char >( text.data(), m ) ); // :block may normalize to nothing
+    }
   };
 
-  std::vector< std::string > sources;
-  constexpr const char* SOURCES{ "txt" };
-  printf( "\n\n Sources from %s\n", SOURCES );
-  for( auto& entry: fs::directory_iterator( SOURCES ) ){
-    unsigned    fsize = entry.file_size();
-    std::string fpath = entry.path().string();
-    printf( "\n   %8u bytes  %s", fsize, fpath.c_str() );
-    sources.push_back( fpath );
+  auto map = [&]( std::span< const char > text, Identity* ids ){
+    for( size_t i = 0; i < text.size(); i++ ) ids[i] = ATOM[ unsigned( text[i] ) ];
+  };
+
+  if( sources.empty() ){
+    printf( "\n\n Sources from %s\n", SOURCES );
+    for( auto& entry: fs::directory_iterator( SOURCES ) ){
+      unsigned    fsize = entry.file_size();
+      std::string fpath = entry.path().string();
+      printf( "\n   %8u bytes  %s", fsize, fpath.c_str() );
+      sources.push_back( fpath );
+    }
   }
-  for( const auto& path: sources ) process( path.c_str() );
-  const double contPerCent = 100.0*hasContinuation/totalSymbolsProcessed;
-  const double compression = double( totalSymbolsProcessed )/chronicle.len();
+  unsigned sequenceLength{ 0 }; // :total length of sequence(s)
+  unsigned distinct      { 0 };
+  Timer timer;
+  if( SHARDS > 1 ){
+                                                                                                                              /*
+    Source `i` is processed by shard `i % SHARDS`; shards share the pattern store:
+                                                                                                                              */
+    std::vector< Tally > tally( SHARDS );
+    ChronicleEngine< DYNAMIC, decltype( hooks ), Records > engine( SHARDS, hooks, [&]( unsigned k, auto& shard, std::span< const Identity > batch ){
+      consume( shard, tally[k], batch );
+    }, std::thread::hardware_concurrency(), DEPTH, CAPACITY, HUGEPAGES );
+    for( unsigned i = 0; i < sources.size(); i++ ){
+      read( sources[i].c_str(), [&]( std::span< const char > text ){
+        std::vector< Identity > batch( text.size() );
+        map( text, batch.data() );
+        engine.feed( i % SHARDS, std::move( batch ) );
+      });
+    }
+    engine.wait();
+    printf( "\n\n Engine: %u shards, %u threads", engine.shards(), engine.threads() );
+    for( unsigned k = 0; k < SHARDS; k++ ){
+      const auto& shard{ engine.shard( k ) };
+      printf( "\n   shard %2u: %10lu symbols  %6lu batches  length %6u  distinct %6u", k,
+              engine.symbols( k ), engine.batches( k ), shard.len(), shard.distinct() );
+      total.symbols         += tally[k].symbols;
+      total.compno          += tally[k].compno;
+      total.compdt          += tally[k].compdt;
+      total.compmax          = std::max( total.compmax, tally[k].compmax );
+      total.hasContinuation += tally[k].hasContinuation;
+      sequenceLength        += shard.len();
+      distinct              += shard.distinct();
+    }
+  } else if( PIPELINE ){
+                                                                                                                              /*
+    Reader thread normalizes and maps input into batches of atom IDs, this thread runs the chronicle:
+                                                                                                                              */
+    Pipeline< Identity, BLOCK, DEPTH > pipe;
+    std::thread reader( [&]{
+      for( const auto& path: sources ){
+        read( path.c_str(), [&]( std::span< const char > text ){
+          map( text, pipe.acquire().data() );
+          pipe.publish( text.size() );
+        });
+      }
+      pipe.close();
+    });
+    for( std::span< const Identity > batch; pipe.next( batch ); ){
+      consume( chronicle, total, batch );
+      pipe.release();
+    }
+    reader.join();
+    printf( "\r Processed %10u symbols", total.symbols );
+    printf( "\n\n Pipeline batches                   %6lu", pipe.batches()       );
+    printf( "\n Pipeline reader waits (ring full)  %6lu",   pipe.producerWaits() );
+    printf( "\n Pipeline chronicle waits (empty)   %6lu",   pipe.consumerWaits() );
+  } else {
+    std::vector< Identity > ids( BLOCK );
+    for( const auto& path: sources ){
+      printf( "\n\n Process `%s`\n", path.c_str() );
+      fflush( stdout );
+      read( path.c_str(), [&]( std::span< const char > text ){
+        map( text, ids.data() );
+        consume( chronicle, total, std::span< const Identity >( ids.data(), text.size() ) );
+      });
+      printf( "\r Processed %10u symbols", total.symbols );
+    }
+  }
+  if( SHARDS == 1 ){
+    sequenceLength = chronicle.len();
+    distinct       = chronicle.distinct();
+  }
+  timer.stop();
+  dt = timer( Timer::MICROSEC );
+  fflush( stdout );
+  const double contPerCent = 100.0*total.hasContinuation/total.symbols;
+  const double compression = double( total.symbols )/sequenceLength;
   printf( "\n\n Total %u symbols processed in %.2f msec ~ %.2f microsec/symbol",
-                totalSymbolsProcessed, dt, dt/totalSymbolsProcessed );
-  double fraction{ double( chronicle.len()/double( CAPACITY ) ) };
-  printf( "\n Sequence length                    %6u elements ~ %.2f %% of capacity", chronicle.len(), 100.0*fraction );
-  printf( "\n Compacted                          %6u times",    compno                    );
-  printf( "\n Gap                                %6u",          chronicle.gap()           );
-  printf( "\n Total number of patterns           %6lu",         PATTERN.size()            );
-  printf( "\n Total number of views              %6lu",         DICTIONARY.size()         );
-  printf( "\n Distinct elements in the sequence  %6u",          chronicle.distinct()      );
+                total.symbols, dt, dt/total.symbols );
+  double fraction{ double( sequenceLength )/double( SHARDS*CAPACITY ) };
+  printf( "\n Sequence length                    %6u elements ~ %.2f %% of capacity", sequenceLength, 100.0*fraction );
+  printf( "\n Compacted                          %6u times",    total.compno              );
+  printf( "\n Compaction time                    %9.2f msec",  0.001*total.compdt        );
+  printf( "\n Longest compaction slice           %9.2f microsec", total.compmax            );
+  printf( "\n Total number of patterns           %6u",          store.patterns()          );
+  printf( "\n Total number of views              %6u",          store.views()             );
+  printf( "\n Distinct elements in the sequence  %6u",          distinct                  );
+  if( SHARDS == 1 ){
+    printf( "\n Gap                                %6u",          chronicle.gap()           );
+    printf( "\n Location map average probe count   %9.2f",        chronicle.probes()        );
+  }
   printf( "\n Cases witch continuations          %9.2f %%",     contPerCent               );
   printf( "\n Sequence compression ratio         %9.2f",        compression               );
   printf( "\n Arena memory allocated             %9.2f Kb",     0.001*arena.occupied()    );
   printf( "\n Arena memory available             %9.2f Kb",     0.001*arena.available()   );
-  printf( "\n Sequence memory                    %9.2f Kb",     0.001*sizeof( chronicle ) );
+  printf( "\n Arena memory reserved              %9.2f Kb",     0.001*arena.capacity()    );
+  printf( "\n Sequence memory                    %9.2f Kb",     0.001*chronicle.memory()  );
+  if( SHARDS == 1 and SNAPSHOT ){                                                                                             /*
+    Save binary snapshot of the chronicle and restore it back:
+                                                                                                                              */
+    Timer save;
+    const bool saved{ chronicle.snapshot( SNAPSHOT ) };
+    save.stop();
+    Timer load;
+    const int restored{ saved ? chronicle.restore( SNAPSHOT ) : -1 };
+    load.stop();
+    printf( "\n Snapshot saved                     %9.2f msec",   save( Timer::MILLISEC )   );
+    printf( "\n Snapshot restored                  %9.2f msec%s", load( Timer::MILLISEC ), restored == 0 ? "" : " FAILED" );
+  }
 
   {                                                                                                                           /*
     Process patterns:
@@ -387,20 +386,22 @@ int main(){
 
     struct{ bool operator()( std::string L, std::string R ) const { return L.size() > R.size(); } } comp;
 
-    for( const auto& [ id, pattern ]: PATTERN ){
-      const unsigned length = pattern.seq.size();
+    std::vector< Identity > ids;
+    store.processPatterns( [&]( const Identity& id ){ ids.push_back( id ); } ); // :callback runs under lock of shared store
+    for( const Identity& id: ids ){
+      const unsigned length = store.length( id );
       if( length > maxLen ) maxLen = length;
-      const std::string seq = lex( id );
-      patterns.push_back( seq );
+      const std::string str = lex( id );
+      patterns.push_back( str );
       if( top.size() < TOP ){
-        top.push_back( seq );
+        top.push_back( str );
       } else {
         if( not sorted ){
           std::ranges::sort( top, comp );
           sorted = true;
         }
-        if( seq.size() > top.back().size() ){
-          top.push_back( seq );
+        if( str.size() > top.back().size() ){
+          top.push_back( str );
           std::ranges::sort( top, comp );
           sorted = true;
           while( top.size() > TOP ) top.pop_back();
@@ -421,7 +422,7 @@ int main(){
     Process continuations:
                                                                                                                               */
     std::unordered_map< Identity, std::unordered_set< Identity > > SEQUEL;
-    for( const auto&[ view, id ]: DICTIONARY ) SEQUEL[ view.head ].insert( view.tail );
+    store.processViews( [&]( const Identity& head, const Identity& tail, const Identity& ){ SEQUEL[ head ].insert( tail ); } );
     std::vector< Identity > CONTEXT;
     for( const auto& [ context, X ]: SEQUEL ) CONTEXT.push_back( context );
 
@@ -9,47 +9,109 @@
 
  NIHIL (default value of Identity) of sequence element assumes missed/nonexistent one.
 
+ Capacity is either template argument or, if it is DYNAMIC, constructor argument.
+ Width of locations and identities is `Narrow` (default) or `Wide`, see `Width`.
+
 
 ________________________________________________________________________________________________________________________________
                                                                                                                               */
 #ifndef CHRONICLE_H_INCLUDED
 #define CHRONICLE_H_INCLUDED
 
+#include <cstdio>
+#include <cstring>
+
 #include <algorithm>
+#include <concepts>
 #include <functional>
+#include <limits>
 #include <span>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "arena.h"
 #include "codec.h"
 #include "def.h"
 #include "flat.h"
 #include "queue.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 
 namespace CoreAGI {
+                                                                                                                              /*
+  Pattern processing policy of the Chronicle: `lex` renders entity as a string (diagnostics only),
+  `sticky` tests suitability of two consequtive subpatterns to form a new pattern, `make` creates
+  new pattern of two subpatterns, `hunt` searches known pattern of two subpatterns (returns NIHIL
+  if there is no such one). Policy type is a template argument, so calls are resolved statically:
+                                                                                                                              */
+  template< typename P > concept ChroniclePolicy = requires( P& p, const P& c, const Identity& a, const Identity& b ){
+    { c.lex   ( a    ) } -> std::convertible_to< std::string >; // :used by const diagnostic methods
+    { p.sticky( a, b ) } -> std::convertible_to< bool        >;
+    { p.make  ( a, b ) } -> std::convertible_to< Identity    >;
+    { p.hunt  ( a, b ) } -> std::convertible_to< Identity    >;
+  };
+                                                                                                                              /*
+  Policy composed of four callables (lambdas, function objects, `std::function`):
+                                                                                                                              */
+  template< typename LEX, typename STICKY, typename MAKE, typename HUNT > struct Hooks {
+    LEX    lex;
+    STICKY sticky;
+    MAKE   make;
+    HUNT   hunt;
+  };
+                                                                                                                              /*
+  Type-erased policy based on `std::function`; used by default to keep the original interface:
+                                                                                                                              */
+  using Functional = Hooks< std::function< std::string( const Identity&                  ) >,
+                            std::function< bool       ( const Identity&, const Identity& ) >,
+                            std::function< Identity   ( const Identity&, const Identity& ) >,
+                            std::function< Identity   ( const Identity&, const Identity& ) > >;
+                                                                                                                              /*
+  Width of the Chronicle records: type of location in the sequence (links of occurences, digram
+  nodes) and key width of the location map. `Narrow` keeps records compact: capacity up to 2^31-1,
+  identities below 2^24. `Wide` accepts any nonzero 32-bit identity and any capacity at the cost
+  of larger records:
+                                                                                                                              */
+  template< typename LOCATION, unsigned KEY_BITS > struct Width {
+    using Location = LOCATION;
+    static constexpr unsigned KEYS{ KEY_BITS };
+    static_assert( std::is_signed_v< Location > ); // :-1 means no location
+  };
 
-  template< unsigned CAPACITY > class Chronicle {
+  using Narrow = Width< int32_t, Flat::PACKED >;
+  using Wide   = Width< int64_t, Flat::WIDE   >;
+
+  template< unsigned CAPACITY, ChroniclePolicy Policy = Functional, typename W = Narrow > class Chronicle {
   public:
                                                                                                                               /*
-    Functions used for pattern processing:
+    Functions used for pattern processing by `Functional` policy:
                                                                                                                               */
     using Lex    = std::function< std::string( const Identity&                  ) >;
     using Act    = std::function< Identity   ( const Identity&, const Identity& ) >;
     using Sticky = std::function< bool       ( const Identity&, const Identity& ) >;
 
-    static_assert( CAPACITY > 5, "Insufficient Chronicle capacity" );
+    static_assert( CAPACITY == DYNAMIC or CAPACITY > 5, "Insufficient Chronicle capacity" );
+
+    using Location = typename W::Location; // :location in the sequence or -1
                                                                                                                               /*
     Sequence element:
                                                                                                                               */
     struct Elem {
 
       Identity id;    // :ID of entity
-      int32_t  prev;  // :location of the previous occurence of this ID or -1
+      Location prev;  // :location of the previous occurence of this ID or -1
+      Location next;  // :location of the next     occurence of this ID or -1
 
-      Elem(                                   ): id( NIHIL ), prev( -1          ){                            }
-      Elem( const Identity& id                ): id( id    ), prev( -1          ){ assert( id != NIHIL     ); }
-      Elem( const Identity& id, unsigned prev ): id( id    ), prev( int( prev ) ){ assert( prev < CAPACITY ); }
+      Elem(                                   ): id( NIHIL ), prev( -1   ), next( -1 ){                        }
+      Elem( const Identity& id                ): id( id    ), prev( -1   ), next( -1 ){ assert( id != NIHIL ); }
+      Elem( const Identity& id, Location prev ): id( id    ), prev( prev ), next( -1 ){ assert( prev >= 0   ); }
 
       bool operator == ( const Elem& e ) const { return id == e.id; }
       bool operator != ( const Elem& e ) const { return id != e.id; }
@@ -63,38 +125,44 @@ namespace CoreAGI {
       Keep information about entity presented in the sequence: index of last occurence and
       index of previous occurence if entity presented twice or more times:
                                                                                                                               */
-      unsigned last; // :location in `seq` of the last instance of referred entity [  0..CAPACITY-1 ]
+      Location last; // :location in `seq` of the last instance of referred entity [  0..CAPACITY-1 ]
       unsigned card; // :number of occurences of item in the `seq`
 
       Ref(                                  ): last{ 0        }, card{ 0    }{}
-      Ref( unsigned location                ): last{ location }, card{ 1    }{}
-      Ref( unsigned location, unsigned card ): last{ location }, card{ card }{}
-      void push( unsigned location ){ last = location;    card++; }
+      Ref( Location location                ): last{ location }, card{ 1    }{}
+      Ref( Location location, unsigned card ): last{ location }, card{ card }{}
+      void push( Location location ){ last = location;    card++; }
       void pull(                   ){ assert( card > 0 ); card--; }
       unsigned num()   const { return card;      }
       bool     empty() const { return card == 0; }
     };
 
-    using Seq = Queue    < Elem, CAPACITY >;
-    using Loc = Flat::Map< Ref,  CAPACITY >;     // :location map: Identity -> Ref
+    struct Pair{
+                                                                                                                              /*
+      Node of the list of occurences of particular digram (pair of adjacent entities); digram
+      is attached to its second element, so node stored at location of the second element:
+                                                                                                                              */
+      Identity lead; // :ID of the preceding presented element or NIHIL if element terminates no digram
+      Location back; // :location of the previous occurence of the same digram or -1
+      Location fore; // :location of the next     occurence of the same digram or -1
+
+      Pair(): lead{ NIHIL }, back{ -1 }, fore{ -1 }{}
+    };
+
+    using Seq = Queue    < Elem, CAPACITY, QueueNature::LOCK_FREE, true >; // :with occupancy bitmap
+    using Loc = Flat::Map< Ref,  1024, 80, false, W::KEYS >; // :location map: Identity -> Ref (initial capacity, grows on demand)
+    using Dig = std::unordered_map< Key, Location >;       // :digram map: combination( pred, succ ) -> location of last occurence
 
     using Set = std::unordered_set< Identity >;  // :set of ID with modified location, so mapping must be redefined
 
-    Lex lex;
-                                                                                                                              /*
-    Function that test suitability to form a new pattern of two consequtive subpatterns;
-    returns NIHIL
-                                                                                                                              */
-    Sticky sticky;
-                                                                                                                              /*
-    Function that creates new pattern of two consequtive subpatterns; returns new Identity or NIHIL:
-                                                                                                                              */
-    Act make;
-                                                                                                                              /*
-    function that search/check for known pattern of two consequtive subpatterns;
-    returns Identity of the known pattern of NIHIL:
-                                                                                                                              */
-    Act hunt;
+    static constexpr size_t LINE{ 64 }; // :cache line size
+
+    static Seq makeSeq( unsigned capacity, bool hugepages ){ // :`seq` of fixed or given capacity
+      if constexpr( CAPACITY == DYNAMIC ) return Seq( capacity, hugepages );
+      else                                return Seq();
+    }
+
+    Policy policy; // :pattern processing functions, see `ChroniclePolicy`
                                                                                                                               /*
     Queue as underline container:
                                                                                                                               */
@@ -107,118 +175,232 @@ namespace CoreAGI {
     Number of NIHIL elements that replace removed ones in the sequence:
                                                                                                                               */
     unsigned holes; // :number of gaps in the sequence
+                                                                                                                              /*
+    Digram index: nodes of the lists of digram occurences (indexed like `seq`)
+    and map of each digram to the last its occurence:
+                                                                                                                              */
+    Arena region; // :memory of `pair` and `remap`
+    Pair* pair;
+    Dig   dig;
+                                                                                                                              /*
+    New location of each element at its old location, filled by `seq.compact` (indexed like `seq`):
+                                                                                                                              */
+    Location* remap;
+                                                                                                                              /*
+    State of the incremental compaction: run of holes collected so far precedes `bubble`:
+                                                                                                                              */
+    Location bubble; // :location of the element next to the run of holes or -1 if no compaction in progress
+    unsigned width;  // :number of holes in the run
+
+    Location before( Location location ) const { return seq.preceding( location ); } // :nearest presented element preceding one at `location` or -1
+    Location after ( Location location ) const { return seq.following( location ); } // :nearest presented element following one at `location` or -1
 
-    void mapLocation(){
+    void attach( Location location, const Identity& lead ){
                                                                                                                               /*
-      Recreate `loc` and recalc `holes`:
+      Register digram [ lead, seq[ location ] ] in the digram index keeping lists
+      ordered by position; usually new node just becomes head of the list:
                                                                                                                               */
-      loc.clear();
-      holes = 0;
-      seq.process(
-        [&]( Elem e, unsigned location )->bool{
-          if( e.id == NIHIL ){ // Hole:
-            holes++;
-          } else { // Actual entity:
-                                                                                                                              /*
-            Items iterated from the head (oldest item) to tail (newest item), so
-            each new occurence of the particular Identity just creates or updates `Locus`:
-                                                                                                                              */
-            Ref* R = loc[ e.id ];
-            if( R ){ // Modify presented:
-              e.prev  = R->last;
-              R->last = location;
-              R->card++;
-            } else { // First occurence:
-              assert( loc.incl( e.id, Ref{ location } ) > 0 );
-            }
-          }
-          return true;
+      Pair& P{ pair[ location ] };
+      assert( P.lead == NIHIL );
+      assert( lead   != NIHIL );
+      P.lead = lead;
+      P.back = P.fore = -1;
+      const auto [ it, inserted ] = dig.try_emplace( combination( lead, seq.ref( location ).id ), location );
+      if( inserted ) return;
+      const unsigned order{ seq.order( location ) };
+      Location head = it->second;
+      if( seq.order( head ) < order ){ // New last occurence:
+        P.back = head;
+        pair[ head ].fore = location;
+        it->second = location;
+        return;
+      }
+      while( pair[ head ].back >= 0 and seq.order( pair[ head ].back ) > order ) head = pair[ head ].back;
+      P.back = pair[ head ].back;
+      P.fore = head;
+      if( P.back >= 0 ) pair[ P.back ].fore = location;
+      pair[ head ].back = location;
+    }
+
+    void detach( Location location ){
+                                                                                                                              /*
+      Exclude digram terminated by `seq[ location ]` (if any) from the digram index:
+                                                                                                                              */
+      Pair& P{ pair[ location ] };
+      if( P.lead == NIHIL ) return;
+      if( P.back >= 0 ) pair[ P.back ].fore = P.fore;
+      if( P.fore >= 0 ) pair[ P.fore ].back = P.back;
+      else {
+        const auto it = dig.find( combination( P.lead, seq.ref( location ).id ) );
+        assert( it != dig.end() and it->second == location );
+        if( P.back >= 0 ) it->second = P.back; else dig.erase( it );
+      }
+      P = Pair{};
+    }
+
+    void link( Location location ){
+                                                                                                                              /*
+      Include element at `location` into the list of occurences of its ID keeping list ordered
+      by position; usually element is the newest one, so it just becomes head of the list:
+                                                                                                                              */
+      Elem& E{ seq.ref( location ) };
+      Ref*  R{ loc[ E.id ]         };
+      if( not R ){ // First occurence:
+        E.prev = E.next = -1;
+        const auto note = loc.incl( E.id, Ref{ location } );
+        assert( note == Loc::INCLUDED or note == Loc::RECOVERED );
+        return;
+      }
+      const unsigned order{ seq.order( location ) };
+      Location succ{ -1      };
+      Location pred{ R->last };
+      while( pred >= 0 and seq.order( pred ) > order ){ succ = pred; pred = seq.ref( pred ).prev; }
+      E.prev = pred;
+      E.next = succ;
+      if( pred >= 0 ) seq.ref( pred ).next = location;
+      if( succ >= 0 ) seq.ref( succ ).prev = location; else R->last = location;
+      R->card++;
+    }
+
+    void unlink( Location location ){
+                                                                                                                              /*
+      Exclude element at `location` from the list of occurences of its ID:
+                                                                                                                              */
+      Elem& E{ seq.ref( location ) };
+      Ref*  R{ loc[ E.id ]         };
+      assert( R and R->card > 0 );
+      if( E.prev >= 0 ) seq.ref( E.prev ).next = E.next;
+      if( E.next >= 0 ) seq.ref( E.next ).prev = E.prev; else R->last = E.prev;
+      if( --R->card == 0 ) loc.excl( E.id );
+      E.prev = E.next = -1;
+    }
+
+    void relocate( Location from, Location into ){
+                                                                                                                              /*
+      Move element from `from` into the hole at `into` (logical order of elements must
+      not be changed) and redirect all references to it:
+                                                                                                                              */
+      seq.move( from, into );
+      Elem& E{ seq.ref( into ) };
+      if( E.prev >= 0 ) seq.ref( E.prev ).next = into;
+      if( E.next >= 0 ) seq.ref( E.next ).prev = into; else loc[ E.id ]->last = into;
+      Pair& P{ pair[ into ] };
+      P = pair[ from ];
+      pair[ from ] = Pair{};
+      if( P.lead == NIHIL ) return;
+      if( P.back >= 0 ) pair[ P.back ].fore = into;
+      if( P.fore >= 0 ) pair[ P.fore ].back = into; else dig[ combination( P.lead, E.id ) ] = into;
+    }
+
+    void mapLocation( unsigned size, Location last ){
+                                                                                                                              /*
+      Redirect references after `seq.compact` moved elements: `remap` holds new location of each
+      element at its old location (-1 for holes); `size` and `last` describe sequence before
+      compaction. Elements moved toward the newest end, so digram nodes are moved in the same
+      order (newest first) without overwriting nodes not moved yet; links, `loc` and `dig` are
+      patched in place instead of rebuilding:
+                                                                                                                              */
+      unsigned i( last );
+      for( unsigned k = 0; k < size; k++, i = ( i + capacity() - 1 ) % capacity() ){
+        const Location into{ remap[i] };
+        if( into < 0 ){ // Hole:
+          pair[i] = Pair{};
+          continue;
         }
-      );
+        Elem& E{ seq.ref( into ) };
+        if( E.prev >= 0 ) E.prev = remap[ E.prev ];
+        if( E.next >= 0 ) E.next = remap[ E.next ];
+        Pair& P{ pair[ into ] };
+        if( into != Location( i ) ){
+          P = pair[i];
+          pair[i] = Pair{};
+          if( E.next < 0 ) loc[ E.id ]->last = into;
+        }
+        if( P.back >= 0 ) P.back = remap[ P.back ];
+        if( P.fore >= 0 ) P.fore = remap[ P.fore ];
+      }
+      for( auto& [ key, location ]: dig ) location = remap[ location ]; // :cheaper than search of each moved digram
     }//mapLocation
 
     void push( const Identity& id ){
 
-      if( id >= Flat::UINT24 ){
-        printf( "\n\n [Chronicle.push] FATAL ERROR: Invalid id = %u >= UINT24 = %u\n\n", id, Flat::UINT24 );
+      if( id >= Loc::LIMIT ){
+        printf( "\n\n [Chronicle.push] FATAL ERROR: Invalid id = %u >= LIMIT = %lu\n\n", id, Loc::LIMIT );
         assert( false );
       }
                                                                                                                               /*
       Push new element into sequence and update `loc` including
       possible `loc` changes due expelling oldest sequence element
                                                                                                                               */
+      const Identity lead   { seq.empty() ? NIHIL : seq.last().id }; // :ID that precedes pushed one
+      const Location leadLoc( seq.lastLoc()                       ); // :its location
+      const bool     full   { seq.size() == capacity()            }; // :oldest element will be expelled
       auto updateExpelled = [&]( std::pair< Elem, Elem > duo ){
                                                                                                                               /*
         Note: `x` is an entity expelled from the `seq`, or NIHIL;
               `y` is a  oldest entity presented in `seq` after `x` expelled (can be NIHIL)
                                                                                                                               */
         auto [ x, y ] = duo;
-        if( x.id != NIHIL ){
+        if( not full ) return;
+        const Location term( seq.lastLoc() ); // : terminal index == index of the expelled item == index of the pushed item
+        if( term == bubble ) bubble = -1; // :incremental compaction to be restarted
+        if( x.id == NIHIL ){ // Hole expelled:
+          holes--;
+          return;
+        }
                                                                                                                               /*
-          So `x` is an actual entity so list of `x` occurences should be updated
+        So `x` is an actual entity so list of `x` occurences should be updated
                                                                                                                               */
-          Ref* Rx = loc[ x.id ];
-          assert( Rx );
-          assert( Rx->card > 0 );
-          if( Rx->card == 1 ){
+        assert( pair[ term ].lead == NIHIL ); // :oldest element terminates no digram
                                                                                                                               /*
-            Expelled entity `x` was presented once so it should be just removed from the `loc`:
+        Digram formed by `x` and next presented element disappears:
                                                                                                                               */
-            loc.excl( x.id );
-          } else {
+        Location next = ( term + 1 ) % Location( capacity() );
+        if( seq.ref( next ).id == NIHIL ) next = after( next );
+        if( next >= 0 ) detach( next );
+
+        Ref* Rx = loc[ x.id ];
+        assert( Rx );
+        assert( Rx->card > 0 );
+        if( Rx->card == 1 ){
                                                                                                                               /*
-            Update list of `x` occurences;
-            Note that expelled `x` may have same ID as newly inserted.
+          Expelled entity `x` was presented once so it should be just removed from the `loc`:
                                                                                                                               */
-            int succ = Rx->last;
-            int term = seq.lastLoc(); // : terminal index == index of the expelled item == index of the pushed item
-            assert( term >= 0 );
-            for(;;){
-              int pred{ seq.ref( succ ).prev };
-              if( pred == term ){
-                seq.ref( succ ).prev = -1; // :end of linked list
-                break;
-              }
-              succ = pred;
-            }
-            Rx->card--;
-          }
+          loc.excl( x.id );
+        } else {
+                                                                                                                              /*
+          Update list of `x` occurences; `x` is the oldest one:
+                                                                                                                              */
+          assert( x.prev == -1 and x.next >= 0 );
+          seq.ref( x.next ).prev = -1;
+          Rx->card--;
         }
       };//updateExpelled
 
-      if( loc.contains( id ) ){
-                                                                                                                              /*
-        Such ID already presented in the sequence:
-                                                                                                                              */
-        Ref* R = loc[ id ];
-        assert( R );
-        Elem e{ id, R->last };
-        updateExpelled( seq.tamp( e ) );
-        R->last = seq.lastLoc();
-        R->card++;
-      } else {
+      updateExpelled( seq.tamp( Elem{ id } ) );
+      link( seq.lastLoc() );
                                                                                                                               /*
-        First occurence of ID:
+      Register digram formed by the pushed element unless its predecessor was expelled:
                                                                                                                               */
-        Elem e{ id };
-        updateExpelled( seq.tamp( e ) );
-        int lastLoc{ seq.lastLoc() }; // :negative means `not exists`
-        assert( lastLoc >= 0 );
-        Ref A{ unsigned( lastLoc ) };
-        loc.incl( e.id, A );
-        assert( loc[ e.id ]->card == 1 and loc[ e.id ]->last == unsigned( lastLoc ) ); // DEBUG
-      }
+      if( lead != NIHIL and leadLoc != seq.lastLoc() ) attach( seq.lastLoc(), lead );
     }
 
     Identity pop(){
+      if( seq.empty() ) return NIHIL;
+      const Location location( seq.lastLoc() );
+      if( location == bubble ) bubble = -1; // :incremental compaction to be restarted
+      detach( location );
       Elem e = seq.pop();
-      if( e.id != NIHIL ){
+      if( e.id == NIHIL ){ // Hole:
+        holes--;
+      } else {
         Ref* R = loc[ e.id ];
         assert( R );
         assert( R->card > 0 );
         if( R->card > 1 ){ // Not a last occurence:
           R->last = e.prev;
           R->card--;
+          seq.ref( e.prev ).next = -1;
         } else { // Last occurence:
           loc.excl( e.id );
         }
@@ -228,14 +410,34 @@ namespace CoreAGI {
 
   public:
 
-    Chronicle( Lex lex, Sticky sticky, Act make, Act hunt ):
-      lex   { lex    },
-      sticky{ sticky },
-      make  { make   },
-      hunt  { hunt   },
-      seq   {        },
-      loc   {        },
-      holes { 0      }
+                                                                                                                              /*
+    If CAPACITY is DYNAMIC, `capacity` is required (it must be representable by `Location`); `seq` ring, digram nodes and `remap` are allocated
+    from anonymous mappings (huge pages if `hugepages`), so capacity can be chosen from configuration
+    without recompilation; their pages are zero (zero `Pair` terminates no digram) and touched lazily:
+                                                                                                                              */
+    Chronicle( Policy policy, unsigned capacity = CAPACITY, bool hugepages = false ):
+      policy{ std::move( policy )                                                             },
+      seq   { makeSeq( capacity, hugepages )                                                   },
+      loc   {                                                                                  },
+      holes { 0                                                                                },
+      region( size_t( capacity )*( sizeof( Pair ) + sizeof( Location ) ) + 4*LINE, 0, hugepages ),
+      pair  { region.template settle< Pair     >( capacity, LINE )                            },
+      dig   {                                                                                  },
+      remap { region.template settle< Location >( capacity, LINE )                            },
+      bubble{ -1                                                                               },
+      width { 0                                                                                }
+    {
+      assert( capacity > 5 and ( CAPACITY == DYNAMIC or capacity == CAPACITY ) );
+      assert( capacity <= uint64_t( std::numeric_limits< Location >::max() ) );
+      assert( pair   );
+      assert( remap  );
+      dig.reserve( capacity );
+    }
+                                                                                                                              /*
+    Original interface: `std::function` callbacks wrapped into `Functional` policy:
+                                                                                                                              */
+    Chronicle( Lex lex, Sticky sticky, Act make, Act hunt ) requires std::same_as< Policy, Functional >:
+      Chronicle( Functional{ lex, sticky, make, hunt } )
     {
       assert( lex    );
       assert( sticky );
@@ -249,32 +451,98 @@ namespace CoreAGI {
 
     explicit operator bool() const { return not seq.empty(); }
 
+    unsigned capacity() const { return seq.capacity();     }  // :maximal number of elements
     bool     empty   () const { return seq.empty();        }
     unsigned size    () const { return seq.size();         }  // :actual size including  excluded elements
     unsigned len     () const { return seq.size() - holes; }  // :logical length without excluded elements
     unsigned gap     () const { return holes;              }  // :number of              excluded elements
+    bool     compacting() const { return bubble >= 0;      }  // :incremental compaction pass in progress
     unsigned distinct() const { return loc.size();         }  // :number of              distinct elements
+    double   probes  () const { return loc.averageProbeCount(); }  // :average DIB of displaced location map entries
+    size_t   memory  () const {                                   // :bytes of the object and its arrays indexed by location
+      const size_t ring{ CAPACITY == DYNAMIC ? sizeof( Elem )*capacity() : 0 }; // :fixed ring is a part of the object
+      return sizeof( *this ) + ring + ( sizeof( Pair ) + sizeof( Location ) )*capacity();
+    }
     Elem     last    () const { return seq.last();         }  // :last element
+                                                                                                                              /*
+    k-th (from the oldest, 0-based) presented element or NIHIL element if k >= len(); holes are skipped
+    by rank/select over the occupancy bitmap, so cost does not depend on number of holes:
+                                                                                                                              */
+    Elem at( unsigned k ) const {
+      const Location location( seq.at( k ) );
+      return location < 0 ? Elem{} : seq.ref( location );
+    }
     Identity lastId  () const { return seq.last().id;      }  // :last element`s ID
                                                                                                                               /*
-    Clear sequence:
+    Clear sequence; pages of digram nodes and `remap` are returned to OS rather than zeroed one by one,
+    so they are zero again and touched lazily as after construction:
                                                                                                                               */
     void reset(){
       seq.clear();
       loc.clear();
-      holes = 0;
+      dig.clear();
+      region.reset();
+      pair  = region.template settle< Pair     >( capacity(), LINE );
+      remap = region.template settle< Location >( capacity(), LINE );
+      assert( pair  );
+      assert( remap );
+      holes  = 0;
+      bubble = -1;
+      width  = 0;
       assert( empty()         );
       assert( distinct() == 0 );
     }
                                                                                                                               /*
-    Reordering sequence to eliminate empty elements (time consiming action):
+    Reordering sequence to eliminate empty elements; elements are moved by blocks and references
+    to them are patched, so cost is proportional to the sequence size:
                                                                                                                               */
     unsigned compact(){ // returns number of eliminated empty elements:
-      const unsigned n{ seq.compact() };
-      holes = 0;
-      mapLocation();
+      const unsigned size{ seq.size()    };
+      const Location last( seq.lastLoc() );
+      const unsigned n   { seq.template compact< Location >( std::span< Location >( remap, capacity() ) ) };
+      assert( n == holes );
+      holes  = 0;
+      bubble = -1;
+      width  = 0;
+      if( n > 0 ) mapLocation( size, last );
       return n;
     }
+                                                                                                                              /*
+    Incremental compaction: visits at most `budget` sequence cells, so can be called after each `incl`
+    instead of `compact()`. Holes are collected into the run that moves from the newest element
+    to the oldest one: each element preceding the run is moved to its end, so sequence
+    stays consistent after each call. When run reaches the oldest end, its holes are removed
+    from the sequence and the call returns; next call starts a new pass if there are holes.
+    Returns number of removed holes:
+                                                                                                                              */
+    unsigned step( unsigned budget ){
+      unsigned removed{ 0 };
+      for( ; budget > 0; budget-- ){
+        if( bubble < 0 ){ // Start new pass:
+          if( holes == 0 ) break;
+          bubble = seq.lastLoc();
+          width  = 0;
+        }
+        const unsigned order{ seq.order( bubble ) };
+        assert( order < seq.size() );
+        if( width > order ) width = order; // :some holes of the run were expelled
+        if( width == order ){ // Run reached the oldest end:
+          for( unsigned i = 0; i < width; i++ ){ const Elem e{ seq.pull() }; assert( e.id == NIHIL ); }
+          holes   -= width;
+          removed += width;
+          bubble   = -1;
+          break;
+        }
+        const Location from( ( uint64_t( bubble ) + 2*uint64_t( capacity() ) - width - 1 ) % capacity() ); // :element preceding the run
+        if( seq.ref( from ).id == NIHIL ){
+          width++;
+        } else {
+          bubble = ( uint64_t( bubble ) + capacity() - 1 ) % capacity();
+          if( width > 0 ) relocate( from, bubble );
+        }
+      }
+      return removed;
+    }
 
     unsigned num( const Identity& id ) const {
                                                                                                                               /*
@@ -282,7 +550,7 @@ namespace CoreAGI {
       so if `id` not contained in `loc` are interpreted as num = 0:
                                                                                                                               */
       assert( id != CoreAGI::NIHIL );
-      assert( id <  Flat::UINT24   );
+      assert( id <  Loc::LIMIT     );
       const Ref* R = loc[ id ];
       return R ? R->card : 0;
     }
@@ -297,8 +565,8 @@ namespace CoreAGI {
         printf( "\n\n [Chronicle.incl] FATAL ERROR: id = %u\n\n", id ); fflush( stdout );
         return false;
       }
-      if( id > Flat::UINT24 ){
-        printf( "\n\n [Chronicle.incl] FATAL ERROR: too big id = %u > UINT24 = %u\n\n", id, Flat::UINT24 ); fflush( stdout );
+      if( id >= Loc::LIMIT ){
+        printf( "\n\n [Chronicle.incl] FATAL ERROR: too big id = %u >= LIMIT = %lu\n\n", id, Loc::LIMIT ); fflush( stdout );
         return false;
       }
 
@@ -307,51 +575,19 @@ namespace CoreAGI {
         return true;
       }
 
-      auto found = [&]( const Identity& pred, const Identity& succ )->std::tuple< int, int >{
+      auto found = [&]( const Identity& pred, const Identity& succ )->std::tuple< Location, Location >{
                                                                                                                               /*
-        Search for adjacent pair of presented occurences of `pred` and `succ`:
+        Search for adjacent pair of presented occurences of `pred` and `succ` using digram index;
+        last occurence of the digram is the pair just pushed, so previous one is required:
                                                                                                                               */
-        Ref* Rp{ loc[ pred ] };                        assert( Rp );
-        if( Rp->card < 2  ) return std::make_tuple( -1, -1 );
-        int predIndex = Rp->last;
-        int predShift { 0 };
-        int predIndex_ = seq.ref( predIndex ).prev;
-        if( predIndex_ > predIndex ){ assert( predShift == 0 ); predShift = CAPACITY; }
-        predIndex = predIndex_;
-
-        Ref* Rs{ loc[ succ ] };                        assert( Rs );
-        if( Rs->card < 2 ){
-          return std::make_tuple( -1, -1 );
-        }
-        int succIndex = Rs->last;
-        int succShift{ 0 };
-        int succIndex_ = seq.ref( succIndex ).prev;
-        if( succIndex_ > succIndex ){ assert( succShift == 0 ); succShift = CAPACITY; }
-        succIndex = succIndex_;
-
-        do {
-          assert( predIndex >= 0 );
-          assert( succIndex >= 0 );
-
-          if( seq.adjacent( predIndex, succIndex ) ) return std::make_tuple( predIndex, succIndex );
-
-          if( ( succIndex - succShift ) > ( predIndex - predShift + 1 ) ){
-            int predIndex_ = seq.ref( predIndex ).prev;
-            if( predIndex_ > predIndex ){ assert( predShift == 0 ); predShift = CAPACITY; }
-            predIndex = predIndex_;
-          } else {
-            int succIndex_ = seq.ref( succIndex ).prev;
-            if( succIndex_ > succIndex ){
-              if( succShift != 0 ){
-                printf( "\n\n succShift=%u while expected to be 0\n", succShift ); fflush( stdout );
-                assert( consistent() );
-              }
-              succShift = CAPACITY;
-            }
-            succIndex = succIndex_;
-          }
-        } while( predIndex >= 0 and succIndex >= 0 );
-        return std::make_tuple( -1, -1 );
+        const auto it = dig.find( combination( pred, succ ) );
+        if( it == dig.end() ) return std::make_tuple( Location( -1 ), Location( -1 ) );
+        assert( it->second == seq.lastLoc() );
+        const Location succIndex{ pair[ it->second ].back };
+        if( succIndex < 0 ) return std::make_tuple( Location( -1 ), Location( -1 ) );
+        const Location predIndex{ before( succIndex ) };
+        assert( predIndex >= 0 and seq.ref( predIndex ).id == pred and seq.ref( succIndex ).id == succ );
+        return std::make_tuple( predIndex, succIndex );
       };//found
                                                                                                                               /*
       Remember last pair of `seq` element that formed by pushing `e`;
@@ -367,15 +603,17 @@ namespace CoreAGI {
                                                                                                                               */
       for(;;){
 
+        if( pred.id == NIHIL ) break; // :sequence holds single element
+
         auto replaceTwoLastByPattern = [&]( const Identity& pattern ){
                                                                                                                               /*
           Replace two last elements of the `seq` by the matched pattern;
           after such action sequence can contain just single element
           and `pred` can be `NIHIL`:
                                                                                                                               */
-          assert( loc.size() >= 2 );
           pop();
-          do pop(); while( last().id == NIHIL );
+          pop();
+          while( not seq.empty() and last().id == NIHIL ) pop(); // :holes that preceded `pred`
           pred = last();
           push( pattern );
           succ = last();
@@ -383,7 +621,7 @@ namespace CoreAGI {
                                                                                                                               /*
         Check if last two items matches some pattern:
                                                                                                                               */
-        const Identity pattern = hunt( pred.id, succ.id );
+        const Identity pattern = policy.hunt( pred.id, succ.id );
         if( pattern != NIHIL ){
                                                                                                                               /*
           Note: pushing pattern into sequence by `push(.)` called from `replaceTwoLastByPattern(.)`
@@ -394,21 +632,18 @@ namespace CoreAGI {
           continue;
         }//if known pattern
 
-        if( not sticky( pred.id, succ.id ) ) break;
+        if( not policy.sticky( pred.id, succ.id ) ) break;
         if( pred.id == succ.id ){
                                                                                                                               /*
           Make new pattern of two consecutive identical ID`s:
                                                                                                                               */
-          Identity pattern = make( succ.id, succ.id ); assert( pattern != NIHIL );
-          assert( loc[ pattern ] == nullptr ); // :no yet such pattern
+          Identity pattern = policy.make( succ.id, succ.id ); assert( pattern != NIHIL );
                                                                                                                               /*
-          Note: pushing pattern into sequence by `push(.)` called from `replaceTwoLastByPattern(.)`
-          set correct loc[.].last and loc[.].card = 1:
+          Note: `make` can return pattern presented in the sequence already (window of repeats of
+          single ID); pushing pattern by `push(.)` called from `replaceTwoLastByPattern(.)` sets
+          correct loc[.].last and loc[.].card in any case:
                                                                                                                               */
-
-          assert( loc.size() >= 2 );
           replaceTwoLastByPattern( pattern );
-          loc[ pattern ]->card = 1;
           continue;
         }//if two identical
                                                                                                                               /*
@@ -417,52 +652,41 @@ namespace CoreAGI {
         auto [ Po, So ] = found( pred.id, succ.id );
         if( Po >= 0 and So >= 0 ){
 
-          assert( Po < int( CAPACITY ) );
-          assert( So < int( CAPACITY ) );
+          assert( Po < Location( capacity() ) );
+          assert( So < Location( capacity() ) );
                                                                                                                               /*
           Make new pattern:
                                                                                                                               */
-          const Identity pattern = make( pred.id, succ.id ); assert( pattern != NIHIL );
-                                                                                                                              /*
-          Replace first occurence by `NIHIL` and `pattern`.
-          Traverse list of `pred` and remove node located at Po:
-                                                                                                                              */
-          Ref* Rp{ loc[ pred.id ] };                               assert( Rp );
-          int P_ = Rp->last;
-          int Pi = seq.ref( P_ ).prev;
-          while( Pi != Po ){ P_ = Pi; Pi = seq.ref( Pi ).prev; }
-          assert( Pi == Po and seq.ref( P_ ).prev == Po );
-          seq.ref( P_ ).prev = seq.ref( Pi ).prev;
-          seq.ref( Po ).prev = -1;
-          seq.ref( Po ).id   = NIHIL;
-          Rp->last = seq.ref( Rp->last ).prev;
-          Rp->card -= 1;
-                                                                                                                              /*
-          Traverse list of `succ` and replace node located at So:
-                                                                                                                              */
-          Ref* Rs{ loc[ succ.id ] };                                assert( Rs );
-          int S_ = Rs->last;
-          int Si = seq.ref( S_ ).prev;
-          while( Si != So ){ S_ = Si; Si = seq.ref( Si ).prev; }
-          assert( Si == So and seq.ref( S_ ).prev == So );
-          seq.ref( S_ ).prev = seq.ref( Si ).prev;
-          seq.ref( So ).prev = -1;
-          seq.ref( So ).id   = pattern;
-          Rs->last = seq.ref( Rs->last ).prev;
-          Rs->card -= 1;
+          const Identity pattern = policy.make( pred.id, succ.id ); assert( pattern != NIHIL );
+                                                                                                                              /*
+          Exclude digrams that disappear after replacement from the digram index:
+                                                                                                                              */
+          const Identity lead{ pair[ Po ].lead }; // :ID preceding first occurence or NIHIL
+          const Location next{ after( So )     }; // :location of element following first occurence
+          assert( next >= 0 );
+          detach( Po );
+          detach( So );
+          detach( next );
+                                                                                                                              /*
+          Replace first occurence by `NIHIL` and `pattern`:
+                                                                                                                              */
+          unlink( Po );
+          unlink( So );
+          seq.punch( Po );
+          seq.ref( So ).id = pattern;
+          link( So );
           holes++;
                                                                                                                               /*
-          Note: pushing pattern into sequence by `push(.)` called from `replaceTwoLastByPattern(.)`
-          set loc[.].card = 1, so correction required:
+          Register digrams formed by `pattern` and its neighbours:
                                                                                                                               */
-          replaceTwoLastByPattern( pattern );
-          Elem* last{ seq.lastRef() }; assert( last );
-          assert( last->id   == pattern );
+          if( lead != NIHIL ) attach( So, lead );
+          attach( next, pattern );
                                                                                                                               /*
-          Link second pattern` occurence to first one and increase counter:
+          Note: pushing pattern into sequence by `push(.)` called from `replaceTwoLastByPattern(.)`
+          links second pattern` occurence to the first one:
                                                                                                                               */
-          last->prev = So;
-          loc[ pattern ]->card = 2; // :correction required!
+          replaceTwoLastByPattern( pattern );
+          assert( seq.last().id == pattern and loc[ pattern ]->card >= 2 );
           continue;
         }//if found
 
@@ -472,6 +696,19 @@ namespace CoreAGI {
       return true;
     }//incl
                                                                                                                               /*
+    Include identities one by one; returns number of them merged with preceding elements
+    into pattern (i.e. last element differs from included identity). Invalid identities
+    are reported and skipped:
+                                                                                                                              */
+    unsigned incl( std::span< const Identity > ids ){
+      unsigned merged{ 0 };
+      for( const Identity& id: ids ){
+        if( not incl( id ) ) continue;
+        if( seq.last().id != id ) merged++;
+      }
+      return merged;
+    }
+                                                                                                                              /*
     Check if sequence contains particular element at least once:
                                                                                                                               */
     bool contains( const Identity& id ) const { return loc.contains( id ); }
@@ -488,15 +725,15 @@ namespace CoreAGI {
       seq.process(
         [&]( const Elem& e, unsigned i )->bool{
           if     ( e.id == NIHIL ) printf( "\n %4u |" ,                     i                                    );
-          else if( e.prev >= 0   ) printf( "\n %4u | %6i <- #%08u `%s`",    i, e.prev, e.id, lex( e.id ).c_str() );
-          else                     printf( "\n %4u |           #%08u `%s`", i,         e.id, lex( e.id ).c_str() );
+          else if( e.prev >= 0   ) printf( "\n %4u | %6li <- #%08u `%s`",   i, long( e.prev ), e.id, policy.lex( e.id ).c_str() );
+          else                     printf( "\n %4u |           #%08u `%s`", i,         e.id, policy.lex( e.id ).c_str() );
           return true;
         },
         true
       );
       printf( "\n Chronicle contains %u distinct entities:", distinct() );
       for( const auto& entry: loc )
-          printf( "\n #%08u  last:%6i  card:%5i | `%s`", entry.key, entry.val.last, entry.val.card, lex( entry.key ).c_str() );
+          printf( "\n #%08u  last:%6li  card:%5u | `%s`", entry.key, long( entry.val.last ), entry.val.card, policy.lex( entry.key ).c_str() );
       printf( "\n" );
       fflush( stdout );
     };
@@ -526,20 +763,24 @@ namespace CoreAGI {
       unsigned err{ 0 };
       seq.process(
         [&]( const Elem& e, unsigned i )->bool{
-          assert( e.id < Flat::UINT24 );
+          assert( e.id < Loc::LIMIT );
           if( not loc.contains( e.id ) ){
-            printf( "\n Location table missed %u `%s`", i, lex( e.id ).c_str() );
+            printf( "\n Location table missed %u `%s`", i, policy.lex( e.id ).c_str() );
             err++;
           }
-          const int link = e.prev;
+          const Location link = e.prev;
           if( link >= 0 ){
-            if( link >= int( CAPACITY ) ){
-              printf( "\n Invalid `seq` link %u `%s` -> %u >= CAPACITY = %u", i, lex( e.id ).c_str(), link, CAPACITY );
+            if( link >= Location( capacity() ) ){
+              printf( "\n Invalid `seq` link %u `%s` -> %li >= CAPACITY = %u", i, policy.lex( e.id ).c_str(), long( link ), capacity() );
               err++;
             } else {
               const Elem& r = seq.ref( link );
               if( r.id != e.id ){
-                printf( "\n Wrong link %u `%s` -> %u `%s`", i, lex( e.id ).c_str(), link, lex( r.id ).c_str() );
+                printf( "\n Wrong link %u `%s` -> %li `%s`", i, policy.lex( e.id ).c_str(), long( link ), policy.lex( r.id ).c_str() );
+                err++;
+              }
+              if( r.next != Location( i ) ){
+                printf( "\n Wrong back link %u `%s` <- %li -> %li", i, policy.lex( e.id ).c_str(), long( link ), long( r.next ) );
                 err++;
               }
             }
@@ -554,49 +795,67 @@ namespace CoreAGI {
         Identity ID   = entry.key;
         Ref      R    = entry.val;
         unsigned len  = 0;
-        int      link = R.last;
-        if( link >= int( CAPACITY ) ){
-            printf( "\n Invalid `loc` link `%s` -> %u >= CAPACITY = %u", lex( ID ).c_str(), link, CAPACITY );
+        Location link = R.last;
+        if( link >= Location( capacity() ) ){
+            printf( "\n Invalid `loc` link `%s` -> %li >= CAPACITY = %u", policy.lex( ID ).c_str(), long( link ), capacity() );
             err++;
         } else {
-          while( link >= 0 and link < int( CAPACITY ) ){
+          while( link >= 0 and link < Location( capacity() ) ){
             len++;
             const Identity id = seq.ref( link ).id;
             if( id != ID ){
-              printf( "\n Invalid ID in the linked list: `%s`..`%s`", lex( ID ).c_str(), lex( id ).c_str() );
+              printf( "\n Invalid ID in the linked list: `%s`..`%s`", policy.lex( ID ).c_str(), policy.lex( id ).c_str() );
               err++;
             }
             link = seq.ref( link ).prev; // :move to next list node
           }
           if( len != R.card ){
-            printf( "\n Invalid `loc` card for `%s`: expected %i but actual equals %i", lex( ID ).c_str(), R.card, len );
+            printf( "\n Invalid `loc` card for `%s`: expected %i but actual equals %i", policy.lex( ID ).c_str(), R.card, len );
             err++;
           }
         }//if link
       }//for entry
+      if( seq.occupied() != len() ){
+        printf( "\n Occupancy bitmap counts %u presented elements but length is %u", seq.occupied(), len() );
+        err++;
+      }
       if( err == 0 ) return true;
       printf( "\n Total %u inconsistencies detected", err );
       return false;
     }//consistent
                                                                                                                               /*
-    Save data as a text file:
+    Format of the file produced by `save`:
+                                                                                                                              */
+    enum class Format { TEXT, BINARY };
+                                                                                                                              /*
+    Save data as a text file or as a binary stream:
                                                                                                                               */
-    bool save( const char* path ){
+    bool save( const char* path, Format format = Format::TEXT ){
                                                                                                                               /*
-      Saves only sequence of entity ID, so output not depends on capacity.
-      Returns `false` if failed to open output file:
+      Saves only sequence of entity ID, so output not depends on capacity. Binary stream starts
+      by MAGIC followed by IDs coded by `Packer`. Returns `false` if failed to write output file:
                                                                                                                               */
-      FILE* out = fopen( path, "w" );
+      FILE* out = fopen( path, format == Format::TEXT ? "w" : "wb" );
       if( not out ) return false;
-      for( const Elem& e: seq.all() ){
-        Encoded< Identity > key( e.id );
-        fprintf( out, "%s\n", key.c_str() );
+      std::vector< Identity > ids;
+      ids.reserve( len() );
+      seq.process( [&]( const Elem& e, unsigned )->bool{ ids.push_back( e.id ); return true; } );
+      bool ok{ true };
+      if( format == Format::TEXT ){
+        std::vector< char > text( ( ENCODED_LIMIT + 1 )*ids.size() + 8 );
+        const size_t n{ encode( ids, text.data() ) };
+        ok = fwrite( text.data(), 1, n, out ) == n;
+      } else {
+        std::vector< uint8_t > data( sizeof( MAGIC ) + Packer::LIMIT*ids.size() );
+        memcpy( data.data(), MAGIC, sizeof( MAGIC ) );
+        Packer packer;
+        const size_t n{ sizeof( MAGIC ) + packer.encode( ids, data.data() + sizeof( MAGIC ) ) };
+        ok = fwrite( data.data(), 1, n, out ) == n;
       }
-      fclose( out );
-      return true;
+      return fclose( out ) == 0 and ok;
     }//save
                                                                                                                               /*
-    Load data from the text file:
+    Load data from the file produced by `save` (format is detected):
                                                                                                                               */
     int load( const char* path, std::function< bool( Identity ) > exist ){
                                                                                                                               /*
@@ -609,21 +868,33 @@ namespace CoreAGI {
       Returns  0 if run correctly
       Returns -1 if source file failed to open.
       Returns -2 if some ID == 0
+      Returns -3 if file is truncated or malformed (not decoded up to the end); current Chronicle state not affected
       Returns unknown ID if such one presented; current Chronicle state not affected
       Returns -ID if incl(.) returns `false`; in such case current Chronicle state affected
                                                                                                                               */
-      FILE* src = fopen( path, "r" );
-      if( not src ) return false;
+      FILE* src = fopen( path, "rb" );
+      if( not src ) return -1;
+      std::vector< char > text;
+      char block[ 64*1024 ];
+      for( size_t n; ( n = fread( block, 1, sizeof( block ), src ) ) > 0; ) text.insert( text.end(), block, block + n );
+      fclose( src );
       std::vector< Identity > sequence;
-      for(;;){
-        Encoded< Identity > EncodedID( src );
-        if( not bool( EncodedID ) ) break;
-        Identity id{ Identity( EncodedID ) };
+      size_t                  consumed{ 0 };
+      if( text.size() >= sizeof( MAGIC ) and memcmp( text.data(), MAGIC, sizeof( MAGIC ) ) == 0 ){
+        const std::span< const uint8_t > data( reinterpret_cast< const uint8_t* >( text.data() ) + sizeof( MAGIC ), text.size() - sizeof( MAGIC ) );
+        sequence.resize( data.size() );                     // :each ID takes at least one byte
+        Packer packer;
+        sequence.resize( packer.decode( data, sequence, &consumed ) );
+        if( consumed < data.size() ) return -3;             // :incomplete or too long varint
+      } else {
+        sequence.resize( text.size()/2 + 1 );               // :each ID takes at least two bytes but the last one
+        sequence.resize( decode( text, sequence, &consumed ) );
+        if( consumed < text.size() ) return -3;             // :invalid token
+      }
+      for( const Identity& id: sequence ){
         if( id == CoreAGI::NIHIL ) return -2;
         if( not exist( id )      ) return id;
-        sequence.push_back( id );
       }
-      fclose( src );
       unsigned n{ 0 };
       for( const Identity& id: sequence ){
         if( not incl( id ) ) return -id;
@@ -632,6 +903,176 @@ namespace CoreAGI {
       return 0;
     }//load
 
+  private:
+                                                                                                                              /*
+    Binary snapshot: this header is followed by the `seq` ring (CAPACITY elements with links),
+    digram nodes (CAPACITY elements), control words and values of the location map (`space`
+    elements each); all of them are written as is. Digram map is rebuilt from the nodes:
+                                                                                                                              */
+    struct Snapshot {
+      char     magic[8];  // :"CHRONSNP"
+      uint32_t version;
+      uint32_t capacity;
+      uint32_t elem;      // :sizeof( Elem )
+      uint32_t pair;      // :sizeof( Pair )
+      uint32_t ref;       // :sizeof( Ref  )
+      uint32_t holes;
+      uint32_t width;
+      int64_t  bubble;
+      uint32_t space;     // :number of slots of the location map
+      uint32_t keys;      // :key width of the location map
+      uint64_t pushed;    // :`seq` counters
+      uint64_t pulled;
+      uint64_t checksum;  // :digest of the header (with zero checksum) and the content
+    };
+
+    static constexpr uint32_t VERSION{ 3 }; // :2 - 64-bit `seq` counters, 3 - 64-bit `bubble`, key width
+
+    static constexpr char MAGIC[4]{ '\0', 'I', 'D', 'S' }; // :binary stream of `save`; zero never starts text
+
+    static uint64_t digest( const void* data, size_t n, uint64_t h ){
+                                                                                                                              /*
+      Word-wise multiplicative digest, continues `h`:
+                                                                                                                              */
+      constexpr uint64_t M{ 0x9E3779B97F4A7C15ull };
+      const uint8_t* p{ static_cast< const uint8_t* >( data ) };
+      for( ; n >= 8; n -= 8, p += 8 ){
+        uint64_t w;
+        memcpy( &w, p, 8 );
+        h = ( h ^ w )*M;
+        h ^= h >> 29;
+      }
+      for( ; n > 0; n--, p++ ) h = ( h ^ *p )*M;
+      return h ^ ( h >> 32 );
+    }
+
+    Snapshot header(){
+      const auto [ pushed, pulled ] = seq.counters();
+      Snapshot H;
+      memset( &H, 0, sizeof( H ) );
+      memcpy( H.magic, "CHRONSNP", sizeof( H.magic ) );
+      H.version  = VERSION;
+      H.capacity = capacity();
+      H.elem     = sizeof( Elem );
+      H.pair     = sizeof( Pair );
+      H.ref      = sizeof( Ref  );
+      H.pushed   = pushed;
+      H.pulled   = pulled;
+      H.holes    = holes;
+      H.bubble   = bubble;
+      H.width    = width;
+      H.space    = loc.tags().size();
+      H.keys     = W::KEYS;
+      return H;
+    }
+
+    int restore( const uint8_t* data, size_t size ){
+      Snapshot H;
+      if( size < sizeof( H ) ) return -2;
+      memcpy( &H, data, sizeof( H ) );
+      const Snapshot E{ header() }; // :expected format
+      if( memcmp( H.magic, E.magic, sizeof( H.magic ) ) != 0
+       or H.version  != E.version
+       or H.capacity != E.capacity
+       or H.elem     != E.elem
+       or H.pair     != E.pair
+       or H.ref      != E.ref
+       or H.keys     != E.keys
+       or H.space    <  2
+       or H.pulled   >  H.pushed
+       or H.pushed   -  H.pulled > capacity() ) return -2;
+      using Tag = typename decltype( loc.tags() )::value_type;
+      const size_t ring { sizeof( Elem )*capacity()                          };
+      const size_t nodes{ sizeof( Pair )*capacity()                          };
+      const size_t slots{ size_t( H.space )*( sizeof( Tag ) + sizeof( Ref ) ) };
+      if( size != sizeof( H ) + ring + nodes + slots ) return -2;
+      const uint64_t checksum{ H.checksum };
+      H.checksum = 0;
+      const uint8_t* p{ data + sizeof( H ) };
+      uint64_t       h{ digest( &H, sizeof( H ), 0 ) };
+      h = digest( p,                sizeof( Elem )*capacity(), h );
+      h = digest( p + ring,         sizeof( Pair )*capacity(), h );
+      h = digest( p + ring + nodes, sizeof( Tag )*H.space,   h );
+      h = digest( p + ring + nodes + sizeof( Tag )*H.space, sizeof( Ref )*H.space, h );
+      if( h != checksum ) return -3;
+                                                                                                                              /*
+      Format is valid, so state is replaced:
+                                                                                                                              */
+      const Elem*    elem{ reinterpret_cast< const Elem* >( p )                        };
+      const Pair*    node{ reinterpret_cast< const Pair* >( p + ring )                 };
+      const Tag*     tag { reinterpret_cast< const Tag*  >( p + ring + nodes )         };
+      const Ref*     val { reinterpret_cast< const Ref*  >( tag + H.space )            };
+      assert( reinterpret_cast< uintptr_t >( p ) % alignof( Elem ) == 0 ); // :sections are 4-byte aligned in the mapping
+      seq.assign( H.pushed, H.pulled, std::span< const Elem >( elem, capacity() ) );
+      memcpy( static_cast< void* >( pair ), node, nodes );
+      loc.assign( std::span< const Tag >( tag, H.space ), std::span< const Ref >( val, H.space ) );
+      holes  = H.holes;
+      bubble = Location( H.bubble );
+      width  = H.width;
+      dig.clear();
+      seq.process( [&]( const Elem& e, unsigned i )->bool{
+        if( pair[i].lead != NIHIL and pair[i].fore < 0 ) dig[ combination( pair[i].lead, e.id ) ] = i;
+        return true;
+      });
+      return 0;
+    }
+
+  public:
+                                                                                                                              /*
+    Save state as a binary snapshot:
+                                                                                                                              */
+    bool snapshot( const char* path ){
+                                                                                                                              /*
+      Unlike `save`, keeps complete state (links, digram nodes, location map, compaction state),
+      so `restore` does not replay the sequence. Snapshot depends on capacity and record layout.
+      Returns `false` if failed to write output file:
+                                                                                                                              */
+      const auto tag{ loc.tags() };
+      const auto val{ loc.vals() };
+      Snapshot   H  { header()   };
+      uint64_t   h  { digest( &H, sizeof( H ), 0 ) };
+      h = digest( seq.raw().data(), sizeof( Elem )*capacity(), h );
+      h = digest( pair,             sizeof( Pair )*capacity(), h );
+      h = digest( tag.data(),       tag.size_bytes(),        h );
+      h = digest( val.data(),       val.size_bytes(),        h );
+      H.checksum = h;
+      FILE* out = fopen( path, "wb" );
+      if( not out ) return false;
+      bool ok{ fwrite( &H, sizeof( H ), 1, out ) == 1 };
+      ok = ok and fwrite( seq.raw().data(), sizeof( Elem ), capacity(), out ) == capacity();
+      ok = ok and fwrite( pair,             sizeof( Pair ), capacity(), out ) == capacity();
+      ok = ok and fwrite( tag.data(),       sizeof( tag[0] ), tag.size(), out ) == tag.size();
+      ok = ok and fwrite( val.data(),       sizeof( val[0] ), val.size(), out ) == val.size();
+      return fclose( out ) == 0 and ok;
+    }//snapshot
+                                                                                                                              /*
+    Restore state from the binary snapshot:
+                                                                                                                              */
+    int restore( const char* path ){
+                                                                                                                              /*
+      Snapshot file is memory mapped and copied into place after validation.
+
+      Returns  0 if restored
+      Returns -1 if file failed to open or to map
+      Returns -2 if format, version, capacity or record layout mismatch
+      Returns -3 if checksum mismatch
+      Current state is not affected unless 0 returned.
+                                                                                                                              */
+      const int fd{ open( path, O_RDONLY ) };
+      if( fd < 0 ) return -1;
+      struct stat info;
+      void* m{ MAP_FAILED };
+      if( fstat( fd, &info ) == 0 and info.st_size > 0 ){
+        m = mmap( nullptr, size_t( info.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+      }
+      close( fd );
+      if( m == MAP_FAILED ) return -1;
+      madvise( m, size_t( info.st_size ), MADV_SEQUENTIAL );
+      const int result{ restore( static_cast< const uint8_t* >( m ), size_t( info.st_size ) ) };
+      munmap( m, size_t( info.st_size ) );
+      return result;
+    }//restore
+
   };//class Chronicle
 
 }//namespace CoreAGI
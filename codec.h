@@ -15,9 +15,19 @@ ________________________________________________________________________________
 #include <cstdio>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
+#include <bit>
+#include <limits>
+#include <span>
 #include <string>
 #include <type_traits>
+#include <vector>
+
+#if defined( __SSE2__ )
+  #include <emmintrin.h>
+#endif
 
 #include "def.h"  // :Identity definition
 
@@ -195,31 +205,317 @@ namespace CoreAGI {
 
   };// class Encoded
                                                                                                                               /*
+  Batch text codec for sequences of Identities; representation of each ID is the same as one
+  of `Encoded< Identity >`. Six-bit digits of an ID are spread into bytes of a 64-bit word, so
+  symbols of two IDs are produced (and parsed) by a few SSE2 byte operations instead of table
+  lookups symbol by symbol:
+                                                                                                                              */
+  constexpr size_t ENCODED_LIMIT{ 6 }; // :max number of symbols representing Identity
+
+  static_assert( sizeof( Identity ) == 4 );
+
+  inline uint64_t spread( Identity x ){
+                                                                                                                              /*
+    Six-bit digits of `x` placed into bytes, least significant digit into byte 0:
+                                                                                                                              */
+    const uint64_t u{ x };
+    return ( u       & 0x3Full       ) | ( u <<  2 & 0x3F00ull         ) | ( u <<  4 & 0x3F0000ull         )
+         | ( u <<  6 & 0x3F000000ull ) | ( u <<  8 & 0x3F00000000ull   ) | ( u << 10 & 0x3F0000000000ull   );
+  }
+
+  inline Identity gather( uint64_t w ){ // :inverse of `spread`
+    return Identity( ( w       & 0x3Full       ) | ( w >>  2 & 0xFC0ull       ) | ( w >>  4 & 0x3F000ull     )
+                   | ( w >>  6 & 0xFC0000ull   ) | ( w >>  8 & 0x3F000000ull  ) | ( w >> 10 & 0xC0000000ull  ) );
+  }
+
+  inline unsigned digits( Identity x ){ return x ? ( 37 - std::countl_zero( x ) )/6 : 1; } // :number of symbols
+
+  inline int digit( char c ){ // :value of symbol or -1
+    if( c >= '0' and c <= '9' ) return c - '0';
+    if( c >= 'a' and c <= 'z' ) return c - 'a' + 10;
+    if( c >= 'A' and c <= 'Z' ) return c - 'A' + 36;
+    if( c == '@'              ) return 62;
+    if( c == '$'              ) return 63;
+    return -1;
+  }
+
+  inline size_t encode( std::span< const Identity > ids, char* out, char separator = '\n' ){
+                                                                                                                              /*
+    Write encoded IDs each followed by `separator`; returns number of written bytes. Capacity of
+    `out` must be at least ( ENCODED_LIMIT + 1 )*ids.size() + 8 (whole words are stored):
+                                                                                                                              */
+    char* const begin{ out };
+    auto ordered = []( Identity x, unsigned len )->uint64_t{ // :most significant digit into byte 0
+      return __builtin_bswap64( spread( x ) << 8*( 8 - len ) );
+    };
+    size_t i{ 0 };
+#if defined( __SSE2__ )
+    const __m128i GT9 { _mm_set1_epi8(  9 ) };
+    const __m128i GT35{ _mm_set1_epi8( 35 ) };
+    const __m128i GT61{ _mm_set1_epi8( 61 ) };
+    const __m128i GT62{ _mm_set1_epi8( 62 ) };
+    for( ; i + 2 <= ids.size(); i += 2 ){
+      const unsigned L{ digits( ids[i] ) }, R{ digits( ids[i+1] ) };
+      const __m128i  v{ _mm_set_epi64x( int64_t( ordered( ids[i+1], R ) ), int64_t( ordered( ids[i], L ) ) ) };
+                                                                                                                              /*
+      '0' + v, then shifts to 'a', 'A', '@', '$' ranges:
+                                                                                                                              */
+      __m128i s{ _mm_add_epi8( v, _mm_set1_epi8( '0' ) ) };
+      s = _mm_add_epi8( s, _mm_and_si128( _mm_cmpgt_epi8( v, GT9  ), _mm_set1_epi8( 'a' - '0' - 10 ) ) );
+      s = _mm_add_epi8( s, _mm_and_si128( _mm_cmpgt_epi8( v, GT35 ), _mm_set1_epi8( 'A' - 'a' - 26 ) ) );
+      s = _mm_add_epi8( s, _mm_and_si128( _mm_cmpgt_epi8( v, GT61 ), _mm_set1_epi8( '@' - '[' ) ) );
+      s = _mm_add_epi8( s, _mm_and_si128( _mm_cmpgt_epi8( v, GT62 ), _mm_set1_epi8( '$' - 'A' ) ) );
+      _mm_storel_epi64( reinterpret_cast< __m128i* >( out ), s );                     out += L; *out++ = separator;
+      _mm_storel_epi64( reinterpret_cast< __m128i* >( out ), _mm_unpackhi_epi64( s, s ) ); out += R; *out++ = separator;
+    }
+#endif
+    for( ; i < ids.size(); i++ ){
+      const unsigned len{ digits( ids[i] ) };
+      const uint64_t w  { ordered( ids[i], len ) };
+      for( unsigned k = 0; k < len; k++ ) out[k] = Encoded< Identity >::SYMBOL[ w >> 8*k & 0x3F ];
+      out += len;
+      *out++ = separator;
+    }
+    return size_t( out - begin );
+  }
+
+  inline size_t decode( std::span< const char > text, std::span< Identity > ids, size_t* consumed = nullptr ){
+                                                                                                                              /*
+    Decode IDs separated by spaces/control symbols; returns number of decoded IDs, that is limited
+    by `ids.size()`. Decoding stops at invalid token (not a symbol or value that exceeds Identity).
+    If `consumed` is not nullptr it receives number of parsed bytes, so it points to invalid token:
+                                                                                                                              */
+    const char* const begin{ text.data()              };
+    const char* const end  { text.data() + text.size() };
+    const char*       p    { begin                     };
+    size_t            n    { 0                         };
+    while( n < ids.size() ){
+      while( p < end and uint8_t( *p ) <= ' ' ) p++;
+      if( p == end ) break;
+#if defined( __SSE2__ )
+      if( p + 8 <= end ){
+        uint64_t w;
+        memcpy( &w, p, 8 );
+        constexpr uint64_t ONES{ 0x0101010101010101ull };
+        const uint64_t sep{ ( w - 0x21*ONES ) & ~w & 0x80*ONES }; // :lowest marked byte is the first one <= ' '
+        const unsigned len{ sep ? unsigned( std::countr_zero( sep ) )/8 : 8 };
+        const __m128i  c    { _mm_cvtsi64_si128( int64_t( w ) ) };
+        auto within = [&]( char lo, char hi ){ return _mm_and_si128( _mm_cmpgt_epi8( c, _mm_set1_epi8( lo - 1 ) ), _mm_cmplt_epi8( c, _mm_set1_epi8( hi + 1 ) ) ); };
+        const __m128i  valid{ _mm_or_si128( _mm_or_si128( within( '0', '9' ), within( 'A', 'Z' ) ),
+                              _mm_or_si128( _mm_or_si128( within( 'a', 'z' ), _mm_cmpeq_epi8( c, _mm_set1_epi8( '@' ) ) ),
+                                                                              _mm_cmpeq_epi8( c, _mm_set1_epi8( '$' ) ) ) ) };
+        const unsigned symbols{ ( 1u << len ) - 1 };
+        const bool     fits   { len < ENCODED_LIMIT or ( len == ENCODED_LIMIT and digit( *p ) < 4 ) }; // :six digits fit 32 bits if the first is < 4
+        if( fits and ( unsigned( _mm_movemask_epi8( valid ) ) & symbols ) == symbols ){
+                                                                                                                              /*
+          Symbol to digit: c - '0', then shifts from 'A', 'a', '@', '$' ranges:
+                                                                                                                              */
+          __m128i d{ _mm_sub_epi8( c, _mm_set1_epi8( '0' ) ) };
+          d = _mm_add_epi8( d, _mm_and_si128( _mm_cmpgt_epi8( c, _mm_set1_epi8( '@' ) ), _mm_set1_epi8( '0' - 'A' + 36 ) ) );
+          d = _mm_add_epi8( d, _mm_and_si128( _mm_cmpgt_epi8( c, _mm_set1_epi8( '`' ) ), _mm_set1_epi8( 'A' - 36 - 'a' + 10 ) ) );
+          d = _mm_add_epi8( d, _mm_and_si128( _mm_cmpeq_epi8( c, _mm_set1_epi8( '@' ) ), _mm_set1_epi8( 62 - '@' + '0' ) ) );
+          d = _mm_add_epi8( d, _mm_and_si128( _mm_cmpeq_epi8( c, _mm_set1_epi8( '$' ) ), _mm_set1_epi8( 63 - '$' + '0' ) ) );
+          const uint64_t v{ uint64_t( _mm_cvtsi128_si64( d ) ) << 8*( 8 - len ) };
+          ids[ n++ ] = gather( __builtin_bswap64( v ) );
+          p += len;
+          continue;
+        }
+      }
+#endif
+      const char* q{ p }; // :near the end of text, long or invalid token
+      uint64_t    u{ 0 };
+      for( ; q < end and uint8_t( *q ) > ' '; q++ ){
+        const int d{ digit( *q ) };
+        if( d < 0 ) break;
+        u = u*64 + unsigned( d );
+        if( u > std::numeric_limits< Identity >::max() ) break;
+      }
+      if( q < end and uint8_t( *q ) > ' ' ) break; // :invalid symbol or value too large, token is not consumed
+      ids[ n++ ] = Identity( u );
+      p = q;
+    }
+    if( consumed ) *consumed = size_t( p - begin );
+    return n;
+  }
+                                                                                                                              /*
+  Binary stream of Identities, 1..5 bytes per ID (LEB128 varint, least significant 7 bits first).
+  Codec keeps window of recently coded distinct IDs: repeated ID is coded by its slot in the window
+  (single byte), any other one by zigzag-coded difference with the previous ID (or by value if
+  `delta` is `false`); the lowest bit of the varint tells the case. Encoder and decoder update
+  their state the same way, so the stream is decoded by a `Packer` that starts in the same state:
+                                                                                                                              */
+  class Packer {
+
+    static constexpr unsigned WINDOW{ 64 }; // :number of recent IDs; slot is coded by single byte
+
+    Identity recent[ WINDOW ]; // :recently coded IDs, NIHIL initially
+    unsigned head;             // :slot to be replaced next
+    Identity prev;             // :previously coded ID
+    bool     delta;
+
+    int slot( Identity id ) const {
+#if defined( __SSE2__ )
+      static_assert( WINDOW % 4 == 0 );
+      const __m128i K{ _mm_set1_epi32( int( id ) ) };
+      for( unsigned k = 0; k < WINDOW; k += 4 ){
+        const __m128i  R{ _mm_loadu_si128( reinterpret_cast< const __m128i* >( recent + k ) ) };
+        const unsigned m{ unsigned( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( R, K ) ) ) ) };
+        if( m ) return int( k ) + std::countr_zero( m );
+      }
+      return -1;
+#else
+      for( unsigned k = 0; k < WINDOW; k++ ) if( recent[k] == id ) return int( k );
+      return -1;
+#endif
+    }
+
+    void update( Identity id, bool hit ){
+      if( not hit ){ recent[ head ] = id; head = ( head + 1 ) % WINDOW; }
+      prev = id;
+    }
+
+    static uint8_t* put( uint8_t* out, uint64_t v ){
+      while( v >= 0x80 ){ *out++ = uint8_t( v ) | 0x80; v >>= 7; }
+      *out++ = uint8_t( v );
+      return out;
+    }
+
+  public:
+
+    static constexpr size_t LIMIT{ 5 }; // :max bytes per ID
+
+    explicit Packer( bool delta = true ): recent{}, head{ 0 }, prev{ NIHIL }, delta{ delta }{}
+
+    void reset(){ for( auto& r: recent ) r = NIHIL; head = 0; prev = NIHIL; }
+
+    size_t encode( std::span< const Identity > ids, uint8_t* out ){
+                                                                                                                              /*
+      Returns number of written bytes; capacity of `out` must be at least LIMIT*ids.size():
+                                                                                                                              */
+      uint8_t* const begin{ out };
+      for( const Identity& id: ids ){
+        const int k{ id != NIHIL ? slot( id ) : -1 };
+        if( k >= 0 ){
+          *out++ = uint8_t( k << 1 | 1 );
+        } else if( delta ){
+          const int32_t  d{ int32_t( id - prev )                     };
+          const uint32_t z{ uint32_t( d << 1 ) ^ uint32_t( d >> 31 ) }; // :zigzag
+          out = put( out, uint64_t( z ) << 1 );
+        } else {
+          out = put( out, uint64_t( id ) << 1 );
+        }
+        update( id, k >= 0 );
+      }
+      return size_t( out - begin );
+    }
+
+    size_t decode( std::span< const uint8_t > data, std::span< Identity > ids, size_t* consumed = nullptr ){
+                                                                                                                              /*
+      Returns number of decoded IDs, that is limited by `ids.size()`; incomplete trailing varint
+      is not consumed. If `consumed` is not nullptr it receives number of parsed bytes:
+                                                                                                                              */
+      const uint8_t* p  { data.data()               };
+      const uint8_t* end{ data.data() + data.size() };
+      size_t         n  { 0                         };
+      while( n < ids.size() and p < end ){
+        uint64_t       v{ 0 };
+        unsigned       s{ 0 };
+        const uint8_t* q{ p };
+        for( ; q < end and s < 7*LIMIT; s += 7 ){
+          v |= uint64_t( *q & 0x7F ) << s;
+          if( not ( *q++ & 0x80 ) ){ s = 0; break; }
+        }
+        if( s != 0 ) break; // :incomplete or too long varint
+        p = q;
+        Identity id;
+        const bool hit{ bool( v & 1 ) };
+        if( hit ){
+          assert( ( v >> 1 ) < WINDOW );
+          id = recent[ ( v >> 1 ) % WINDOW ];
+        } else if( delta ){
+          const uint32_t z{ uint32_t( v >> 1 ) };
+          id = prev + Identity( ( z >> 1 ) ^ -( z & 1 ) );
+        } else {
+          id = Identity( v >> 1 );
+        }
+        update( id, hit );
+        ids[ n++ ] = id;
+      }
+      if( consumed ) *consumed = size_t( p - data.data() );
+      return n;
+    }
+
+  };//class Packer
+                                                                                                                              /*
   Utility function:
    - read encodeed entity ID`s from the file `src` up to `separator` of enf of file;
    - decodes ID;
    - return firts ID as result (or 0 in case of empty record);
    - call f(.) for each followed ID
                                                                                                                               */
-  Identity readAndDecode( std::function< void( Identity ) >f, FILE* src, char EOL = '\n' ){
+  template< typename F > Identity readAndDecode( F f, FILE* src, char EOL = '\n' ){
     assert( src );
                                                                                                                               /*
-    Load first ID:
+    Read record up to `EOL` and decode it by batches:
+                                                                                                                              */
+    char*   line{ nullptr };
+    size_t  size{ 0       };
+    const ssize_t len{ getdelim( &line, &size, EOL, src ) };
+    Identity ID{ NIHIL };
+    if( len > 0 ){
+      constexpr size_t BATCH{ 256 };
+      Identity batch[ BATCH ];
+      std::span< const char > text( line, size_t( len ) );
+      bool first{ true };
+      for(;;){
+        size_t consumed{ 0 };
+        const size_t n{ decode( text, batch, &consumed ) };
+        if( n == 0 ) break;
+        for( size_t i = 0; i < n; i++ ){
+          if( first ){ ID = batch[i]; first = false; } else f( batch[i] );
+        }
+        text = text.subspan( consumed );
+      }
+    }
+    free( line );
+    return ID;
+  }
+                                                                                                                              /*
+  Binary record: varint number of IDs followed by IDs coded by `packer`:
                                                                                                                               */
-    char separator{ EOL };
-    const Encoded< Identity > first{ src, &separator }; // :read first encoded ID
-    if( not bool( first ) ) return NIHIL;
-    Identity ID{ Identity( first ) };
+  inline bool writeRecord( FILE* out, std::span< const Identity > ids, Packer& packer ){
+    assert( out );
+    std::vector< uint8_t > data( Packer::LIMIT*( ids.size() + 1 ) );
+    uint64_t n{ ids.size() };
+    size_t   k{ 0          };
+    while( n >= 0x80 ){ data[ k++ ] = uint8_t( n ) | 0x80; n >>= 7; }
+    data[ k++ ] = uint8_t( n );
+    k += packer.encode( ids, data.data() + k );
+    return fwrite( data.data(), 1, k, out ) == k;
+  }
                                                                                                                               /*
-    Load rest of ID`s:
+  Same as `readAndDecode` above for binary record written by `writeRecord`:
                                                                                                                               */
-    if( separator != EOL ){ // Read encoded, append decoded to `seq`:
-      for(;;){
-        const Encoded< Identity > next{ src, &separator };
-        if( not bool( next ) ) break;
-        f( Identity( next ) );
-        if( separator == EOL ) break;
+  template< typename F > Identity readAndDecode( F f, FILE* src, Packer& packer ){
+    assert( src );
+    uint64_t n{ 0 };
+    for( unsigned s = 0; s < 64; s += 7 ){
+      const int c{ fgetc( src ) };
+      if( c < 0 ) return NIHIL;
+      n |= uint64_t( c & 0x7F ) << s;
+      if( not ( c & 0x80 ) ) break;
+    }
+    Identity ID{ NIHIL };
+    uint8_t  data[ Packer::LIMIT ];
+    for( uint64_t i = 0; i < n; i++ ){
+      size_t k{ 0 };
+      for( int c; k < Packer::LIMIT and ( c = fgetc( src ) ) >= 0; ){
+        data[ k++ ] = uint8_t( c );
+        if( not ( c & 0x80 ) ) break;
       }
+      Identity id;
+      if( packer.decode( std::span< const uint8_t >( data, k ), std::span< Identity >( &id, 1 ) ) == 0 ) break;
+      if( i == 0 ) ID = id; else f( id );
     }
     return ID;
   }
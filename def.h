@@ -42,6 +42,7 @@ namespace CoreAGI {
   }//combine
 
   constexpr const Identity    NIHIL { 0  };  // :identity of nonexistent quasi-entity
+  constexpr const unsigned    DYNAMIC{ 0 };  // :container capacity given at run time instead of template argument
             const std::string NIL   { "" };  // :empty string
 
 
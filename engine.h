@@ -0,0 +1,181 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Chronicle engine: N independent `Chronicle` shards (one per input stream or set of
+ documents) processed by a pool of worker threads. Shard is processed by one worker at
+ a time, so `Chronicle` itself needs no synchronization; policy of all shards usually
+ refers to the same `SharedPatternStore`, so pattern made by one shard is hunted by the
+ others. Batches of atoms are fed to shards asynchronously; feeding waits while the shard
+ has DEPTH unprocessed batches (backpressure).
+
+ 2021.03.30
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#ifndef ENGINE_H_INCLUDED
+#define ENGINE_H_INCLUDED
+
+#include <cassert>
+#include <cstdint>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "chronicle.h"
+#include "def.h"
+
+namespace CoreAGI {
+
+  template< unsigned CAPACITY, ChroniclePolicy Policy, typename W = Narrow > class ChronicleEngine {
+
+  public:
+
+    using Shard   = Chronicle< CAPACITY, Policy, W >;
+    using Batch   = std::vector< Identity >;
+    using Process = std::function< void( unsigned shard, Shard& chronicle, std::span< const Identity > batch ) >;
+
+  private:
+
+    struct Lane {
+      std::unique_ptr< Shard > chronicle;
+      std::deque< Batch >      pending;   // :batches fed but not taken by worker
+      bool                     scheduled; // :lane is in the `ready` queue or processed by worker
+      uint64_t                 batches;   // :processed batches
+      uint64_t                 symbols;   // :processed atoms
+    };
+
+    const unsigned             DEPTH;
+    Process                    process;
+    std::vector< Lane >        lane;
+    std::deque< unsigned >     ready;  // :lanes that have pending batches and no worker
+    std::mutex                 mutex;
+    std::condition_variable    work;   // :`ready` is not empty or engine stops
+    std::condition_variable    done;   // :some batches were processed
+    bool                       stop;
+    std::vector< std::thread > worker;
+
+    void serve(){
+      std::unique_lock< std::mutex > lock( mutex );
+      for(;;){
+        work.wait( lock, [&]{ return stop or not ready.empty(); } );
+        if( ready.empty() ) return; // :stop
+        const unsigned k{ ready.front() };
+        ready.pop_front();
+        Lane& L{ lane[k] };
+        std::deque< Batch > taken;
+        taken.swap( L.pending );
+        lock.unlock();
+        done.notify_all(); // :lane has room for new batches
+        uint64_t symbols{ 0 };
+        for( const Batch& batch: taken ){
+          process( k, *L.chronicle, batch );
+          symbols += batch.size();
+        }
+        lock.lock();
+        L.batches += taken.size();
+        L.symbols += symbols;
+        if( L.pending.empty() ){
+          L.scheduled = false;
+        } else {
+          ready.push_back( k ); // :round robin: other lanes go first
+          work.notify_one();
+        }
+        done.notify_all();
+      }
+    }
+
+  public:
+                                                                                                                              /*
+    `process( k, chronicle, batch )` includes batch into chronicle of shard `k` (and compacts it when
+    required); it is called by worker threads, never concurrently for the same shard:
+                                                                                                                              */
+    ChronicleEngine( unsigned shards, const Policy& policy, Process process,
+                     unsigned threads = std::thread::hardware_concurrency(), unsigned depth = 8,
+                     unsigned capacity = CAPACITY /* required if CAPACITY is DYNAMIC */, bool hugepages = false ):
+      DEPTH  { std::max( depth, 1u ) },
+      process{ process               },
+      lane   ( shards                ),
+      ready  {                       },
+      mutex  {                       },
+      work   {                       },
+      done   {                       },
+      stop   { false                 },
+      worker {                       }
+    {
+      assert( shards > 0 );
+      for( auto& L: lane ){
+        L.chronicle = std::make_unique< Shard >( policy, capacity, hugepages );
+        L.scheduled = false;
+        L.batches   = 0;
+        L.symbols   = 0;
+      }
+      threads = std::clamp( threads, 1u, shards ); // :more workers than shards would stay idle
+      for( unsigned i = 0; i < threads; i++ ) worker.emplace_back( [this]{ serve(); } );
+    }
+
+    ChronicleEngine( const ChronicleEngine& ) = delete;
+    ChronicleEngine& operator = ( const ChronicleEngine& ) = delete;
+
+   ~ChronicleEngine(){
+      wait();
+      {
+        std::lock_guard< std::mutex > lock( mutex );
+        stop = true;
+      }
+      work.notify_all();
+      for( auto& w: worker ) w.join();
+    }
+
+    unsigned shards () const { return lane.size();   }
+    unsigned threads() const { return worker.size(); }
+
+    void feed( unsigned k, Batch batch ){
+                                                                                                                              /*
+      Queue batch of atoms for shard `k`; waits while shard has DEPTH unprocessed batches:
+                                                                                                                              */
+      assert( k < lane.size() );
+      if( batch.empty() ) return;
+      std::unique_lock< std::mutex > lock( mutex );
+      Lane& L{ lane[k] };
+      done.wait( lock, [&]{ return L.pending.size() < DEPTH; } );
+      L.pending.push_back( std::move( batch ) );
+      if( not L.scheduled ){
+        L.scheduled = true;
+        ready.push_back( k );
+        work.notify_one();
+      }
+    }
+
+    void wait(){
+                                                                                                                              /*
+      Wait until all fed batches are processed:
+                                                                                                                              */
+      std::unique_lock< std::mutex > lock( mutex );
+      done.wait( lock, [&]{
+        for( const auto& L: lane ) if( L.scheduled ) return false;
+        return true;
+      });
+    }
+                                                                                                                              /*
+    Access to shards and their counters; valid when engine is idle (after `wait`):
+                                                                                                                              */
+          Shard& shard( unsigned k )       { assert( k < lane.size() ); return *lane[k].chronicle; }
+    const Shard& shard( unsigned k ) const { assert( k < lane.size() ); return *lane[k].chronicle; }
+
+    uint64_t batches( unsigned k ) const { assert( k < lane.size() ); return lane[k].batches; }
+    uint64_t symbols( unsigned k ) const { assert( k < lane.size() ); return lane[k].symbols; }
+
+  };//class ChronicleEngine
+
+}//namespace CoreAGI
+
+#endif // ENGINE_H_INCLUDED
@@ -11,6 +11,10 @@
 
   `Flat` hash table (contigous memory, no memory allocations when new element inserted)
 
+  Key width is PACKED (24-bit keys share 32-bit control word with DIB, default) or WIDE (control
+  word is the whole 32-bit key and DIB is kept in separate byte array, so group search compares
+  keys without masking).
+
 
   2020.12.03
 ________________________________________________________________________________________________________________________________
@@ -20,14 +24,22 @@ ________________________________________________________________________________
 
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
+#include <bit>          // std::bit_ceil, std::countr_zero
+
+#include <algorithm>    // std::max
 #include <utility>      // std::move
 #include <vector>
 #include <span>
 #include <string>
 #include <sstream>
 #include <iomanip>
+
+#if defined( __AVX2__ ) or defined( __SSE2__ )
+  #include <immintrin.h>
+#endif
                                                                                                                               /*
 NB Suppress warning:
                                                                                                                               */
@@ -39,22 +51,103 @@ namespace CoreAGI::Flat {
   constexpr uint32_t NIHIL { 0       };
   constexpr uint32_t UINT24{ 1 << 24 };
 
+  constexpr unsigned PACKED{ 24 }; // :key width: key and DIB share control word
+  constexpr unsigned WIDE  { 32 }; // :key width: control word is key, DIB is kept out of line
+
   using Elem = uint32_t; // :element of the Set
   using Key  = uint32_t; // :key     of the Map
 
-  template< unsigned CAPACITY, unsigned LOAD_FACTOR_PERCENT = 80 > class Set {
+  constexpr uint32_t PHI{ 2654435769u }; // :2^32/golden ratio, fibonacci hashing multiplier
+                                                                                                                              /*
+  Control word of the slot: key and its distance to initial bucket (DIB); zero key means vacant slot.
+  Keys are less than LIMIT:
+                                                                                                                              */
+  template< unsigned KEY_BITS > struct Tag;
+
+  template<> struct Tag< PACKED > {
+    static constexpr uint64_t LIMIT{ UINT24 };
+    Key     key : 24;
+    uint8_t dib :  8;
+  };
 
-    static constexpr unsigned SPACE = CAPACITY*100/LOAD_FACTOR_PERCENT;
+  template<> struct Tag< WIDE > {
+    static constexpr uint64_t LIMIT{ uint64_t( 1 ) << 32 };
+    Key key;
+  };
+
+  static_assert( sizeof( Tag< PACKED > ) == sizeof( uint32_t ) );
+  static_assert( sizeof( Tag< WIDE   > ) == sizeof( uint32_t ) );
+                                                                                                                              /*
+  Number of control words compared by single SIMD instruction; 1 means scalar search only.
+  Robin Hood placement keeps `key` within [ home, home + maximal DIB ], so when maximal DIB
+  is less than GROUP single comparison resolves whole probe sequence:
+                                                                                                                              */
+#if defined( __AVX2__ )
+  constexpr unsigned GROUP{ 8 };
+#elif defined( __SSE2__ )
+  constexpr unsigned GROUP{ 4 };
+#else
+  constexpr unsigned GROUP{ 1 };
+#endif
+
+  template< unsigned KEY_BITS > inline unsigned scan( const Tag< KEY_BITS >* tag, Key key, unsigned reach ){
+                                                                                                                              /*
+    Returns offset of `key` among tag[ 0..reach ] or GROUP if not found;
+    tag[ 0..GROUP-1 ] must be readable and reach < GROUP:
+                                                                                                                              */
+    assert( reach < GROUP );
+    unsigned match{ 0 };
+#if defined( __AVX2__ )
+    __m256i K{ _mm256_loadu_si256( reinterpret_cast< const __m256i* >( tag ) ) };
+    if constexpr( KEY_BITS == PACKED ) K = _mm256_and_si256( K, _mm256_set1_epi32( UINT24 - 1 ) );
+    match = _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( K, _mm256_set1_epi32( key ) ) ) );
+#elif defined( __SSE2__ )
+    __m128i K{ _mm_loadu_si128( reinterpret_cast< const __m128i* >( tag ) ) };
+    if constexpr( KEY_BITS == PACKED ) K = _mm_and_si128( K, _mm_set1_epi32( UINT24 - 1 ) );
+    match = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( K, _mm_set1_epi32( key ) ) ) );
+#else
+    match = tag[0].key == key;
+#endif
+    match &= ( 2u << reach ) - 1;
+    return match ? unsigned( std::countr_zero( match ) ) : GROUP;
+  }
+                                                                                                                              /*
+  Slot layout of the Set and initial slot layout of the Map (Map doubles it on growth). By default the table has SPACE = CAPACITY*100/LOAD_FACTOR_PERCENT
+  slots and the raw key modulo SPACE is the initial bucket. With POWER_OF_TWO the number of slots is
+  rounded up to a power of two, positions wrap by mask and the initial bucket is taken from the high
+  bits of the fibonacci (multiplicative) hash of the key, that spreads nearby ids over the table:
+                                                                                                                              */
+  template< unsigned CAPACITY, unsigned LOAD_FACTOR_PERCENT, bool POWER_OF_TWO > struct Layout {
+
+    static constexpr unsigned BASE { CAPACITY*100/LOAD_FACTOR_PERCENT            };
+    static constexpr unsigned SPACE{ POWER_OF_TWO ? std::bit_ceil( BASE ) : BASE };
+    static constexpr unsigned SHIFT{ 32 - unsigned( std::countr_zero( SPACE ) )  }; // :POWER_OF_TWO only
+
+    static_assert( SPACE > 1 );
+
+    static unsigned home( uint32_t key ){
+      if constexpr( POWER_OF_TWO ) return uint32_t( key*PHI ) >> SHIFT;
+      else                         return key % SPACE;
+    }
+
+    static unsigned next( unsigned i ){
+      if constexpr( POWER_OF_TWO ) return ( i + 1 ) & ( SPACE - 1 );
+      else                         return ( i + 1 ) % SPACE;
+    }
+
+  };//struct Layout
+
+  template< unsigned CAPACITY, unsigned LOAD_FACTOR_PERCENT = 80, bool POWER_OF_TWO = false > class Set {
+
+    using Slot = Layout< CAPACITY, LOAD_FACTOR_PERCENT, POWER_OF_TWO >;
+
+    static constexpr unsigned SPACE = Slot::SPACE;
 
     static_assert( std::is_trivially_copyable< Elem >::value );
 
   public:
 
-    struct Entry {
-      Elem    key : 24;
-      uint8_t dib :  7;
-      bool    del :  1;
-    };
+    using Entry = Tag< PACKED >;
 
     enum Note: int8_t {
                                                                                                                               /*
@@ -64,7 +157,7 @@ namespace CoreAGI::Flat {
       EXHAUSTED = 0, // :not inserted because capacity exceeded
       INCLUDED  = 1, // :OK, included
       EXCLUDED  = 2, // :OK, excluded
-      RECOVERED = 3, // :inserted element that was deleted earlier
+      RECOVERED = 3, // :not used since deletion does not leave tombstones
       CONTAINED = 4, // :not inserted because already presented
       NOT_FOUND = 5, // :not excluded because not presented
       EMPTY_SET = 6  // :not excluded/included because empty set
@@ -87,16 +180,17 @@ namespace CoreAGI::Flat {
   private:
 
 	  uint32_t cardinal;
-	  Entry    data[ SPACE ];
+	  unsigned reach;                 // :maximal DIB since last clear
+	  Entry    data[ SPACE + GROUP ]; // :vacant tail allows group comparison at any position
 
   public:
 
 	  std::string content() const {
 	    std::stringstream out;
 	    out << std::setw( 4 ) << cardinal << " {";
-	    for( const auto& e: data ){
+	    for( unsigned i = 0; i < SPACE; i++ ){
+	      const Entry& e{ data[i] };
 	      if( e.key == 0 ) out << "  empty ";
-	      else if( e.del ) { out << " (" << std::setw( 3 ) << e.key << ')' << '`' << unsigned( e.dib ); }
 	      else             { out << "  " << std::setw( 3 ) << e.key << ' ' << '`' << unsigned( e.dib ); }
 	    }
 	    out << " }";
@@ -105,83 +199,72 @@ namespace CoreAGI::Flat {
 
   private:
 
-    Note rehash( Entry e, unsigned depth ){
-                                                                                                                              /*
-      Collect all currently presented elements into the temporary array E:
-                                                                                                                              */
-      Elem E[ SPACE ];
-      unsigned n{ 0 };
-      for( unsigned i = 0; i < SPACE; i++ ) if( data[i].key != 0 and not data[i].del ) E[n++] = data[i].key;
-      clear();
-      for( unsigned i = 0; i < n; i++ ) assert( incl( E[i], depth + 1 ) );
+	  Note incl_( Elem elem ){
                                                                                                                               /*
-      Finally add `elem` if any:
+      Robin Hood insertion: `elem` takes the first slot whose entry is closer to its initial bucket
+      than `elem` would be, entries from there up to the vacant slot are shifted one position forward.
+      Vacant slot always exists ( CAPACITY < SPACE ), so the only failure is DIB that does not fit into
+      the control word; it is detected before anything is moved:
                                                                                                                               */
-      if( e.key and not e.del ) assert( incl_( e.key, depth + 1 ) == INCLUDED );
-      return INCLUDED;
-
-    }
-
-	  Note incl_( Elem elem, unsigned depth = 0 ){
+	    assert( elem != NIHIL  );
 	    assert( elem  < UINT24 );
-	    assert( depth < 2      );
 	    if( cardinal >= CAPACITY ) return EXHAUSTED;
-      unsigned i{ elem % SPACE                  }; // :desired position
-      Entry    e{ elem, 0, false };                // :DIB (distance to initial bucket) is zero initially
-      unsigned step{ 0 };
-      for( unsigned c = i; ; c = ( c + 1 ) % SPACE ){
-		    if( data[c].key == 0 ){ // Vacant cell, insert here
-			    data[c] = e;
-			    cardinal++;
-			    return INCLUDED;
-		    }
-		    if( data[c].key == e.key ){ // Presented or deleted
-			    if( data[c].del ){ // Sometime was presented but deleted - just recovery:
-			      data[c].del = false;
-			      cardinal++;
-			      return RECOVERED;
-			    } else { // Presented:
-			      return CONTAINED;
-			    }
-			    break;
-		    }
-		    step++;
-			  if( data[c].dib < e.dib ){ // To be swapped because it is rich.
-			                                                                                                                        /*
-			    Swap `e` and `data[c]`, i.e. insert here but move current element to some another place
-			                                                                                                                        */
-          std::swap( e, data[c] );
-        }//if
-        constexpr unsigned DIB_LIMIT{ 7 }; // :rehashing criterion
-        if( e.dib >= DIB_LIMIT or step > SPACE/2 ){ return rehash( e, depth ); }
-		    else e.dib++; //:the entry to be inserted goes away from ideal position gradually
-      }// for c
-		  return INCLUDED;
+      constexpr unsigned DIB_MAX{ 255 }; // :8-bit DIB
+      unsigned c  { Slot::home( elem ) }; // :desired position
+      unsigned dib{ 0                  };
+      for( ; data[c].key != 0 and data[c].dib >= dib; c = Slot::next( c ), dib++ ){
+        if( data[c].key == elem ) return CONTAINED; // :presented
+        if( dib == DIB_MAX      ) return EXHAUSTED;
+      }
+      unsigned v{ c }; // :first vacant slot
+      for( ; data[v].key != 0; v = Slot::next( v ) ) if( data[v].dib == DIB_MAX ) return EXHAUSTED;
+      for( unsigned j = v; j != c; ){
+        const unsigned i{ j == 0 ? SPACE - 1 : j - 1 }; // :previous slot
+        data[j] = data[i];
+        data[j].dib++;
+        reach = std::max( reach, unsigned( data[j].dib ) );
+        j = i;
+      }
+      data[c] = Entry{ elem, uint8_t( dib ) };
+      reach   = std::max( reach, dib );
+      cardinal++;
+      return INCLUDED;
 	  }//incl
 
+    unsigned find( const Elem elem ) const {
+                                                                                                                              /*
+      Returns position of `elem` or SPACE if not presented; search stops at vacant cell or at entry
+      that is closer to its initial bucket than `elem` would be (Robin Hood invariant), so number
+      of probes is bounded by maximal DIB:
+                                                                                                                              */
+	    assert( elem != NIHIL );
+	    assert( elem < UINT24 );
+      unsigned i{ Slot::home( elem ) };
+      if constexpr( GROUP > 1 ){
+        if( reach < GROUP and i + reach < SPACE ){ // :probe sequence does not wrap around
+          const unsigned k{ scan( data + i, elem, reach ) };
+          return k < GROUP ? i + k : SPACE;
+        }
+      }
+      for( unsigned dib = 0; ; dib++ ){
+        const Entry& e{ data[i] };
+        if( e.key == elem             ) return i;
+        if( e.key == 0 or e.dib < dib ) return SPACE;
+		    i = Slot::next( i );
+      }
+    }
+
   public:
 
     void clear(){
       cardinal = 0;
-	    memset( data, 0, sizeof( Entry )*SPACE );
+      reach    = 0;
+	    memset( data, 0, sizeof( data ) );
     }
 
-    Set(): cardinal{ 0 }, data{}{ memset( data, 0, sizeof( Entry )*SPACE );	}
+    Set(): cardinal{ 0 }, reach{ 0 }, data{}{ memset( data, 0, sizeof( data ) );	}
 
-    bool contains( const Elem elem ) const {
-	    assert( elem != NIHIL );
-	    assert( elem < UINT24 );
-	    if( cardinal == 0  ) return false;
-      unsigned i{ elem % SPACE };
-	    while( data[i].key != elem ){
-		    i = ( i + 1 ) % SPACE;
-		    if( i == elem % SPACE ) return false;	// :not Found, vacant call reached
-      }
-                                                                                                                              /*
-      Key found, but it may be deleted, so result depends on date[.].del:
-                                                                                                                              */
-	    return not data[i].del;
-    }
+    bool contains( const Elem elem ) const { return find( elem ) < SPACE; }
 
     bool contains( const std::span< Elem > elem ) const {
       if( elem.size() > cardinal ) return false;
@@ -193,28 +276,28 @@ namespace CoreAGI::Flat {
 	    assert( elem != NIHIL );
 	    assert( elem < UINT24 );
 	    if( cardinal == 0 ) return EMPTY_SET;
-      unsigned i{ elem % SPACE };
-	    while( data[i].key != elem ){
-		    i = ( i + 1 ) % SPACE;
-		    if( i == elem % SPACE ){
-		      return NOT_FOUND;	// :not Found
-		    }
-      }
+      unsigned i{ find( elem ) };
+      if( i >= SPACE ) return NOT_FOUND;
                                                                                                                               /*
-      Key found, mark it as deleted:
+      Key found; backward shift deletion: shift following entries of the
+      same cluster one position back until vacant or well placed entry:
                                                                                                                               */
-      if( not data[i].del ){
-        data[i].del = true;
-        cardinal--;
-        return EXCLUDED;
+      for(;;){
+        const unsigned j{ Slot::next( i ) };
+        if( data[j].key == 0 or data[j].dib == 0 ) break;
+        data[i] = data[j];
+        data[i].dib--;
+        i = j;
       }
-      return NOT_FOUND; // :the item has already been deleted earlier
+      data[i] = Entry{ 0, 0 };
+      cardinal--;
+      return EXCLUDED;
     }
 
-    Note incl( Elem elem, unsigned depth = 0 ){ return incl_( elem, depth ); }
+    Note incl( Elem elem ){ return incl_( elem ); }
 
-	  Set( std::initializer_list< Elem > E ): cardinal{ 0 }, data{}{
-      memset( data, 0, sizeof( Entry )*SPACE );
+	  Set( std::initializer_list< Elem > E ): cardinal{ 0 }, reach{ 0 }, data{}{
+      memset( data, 0, sizeof( data ) );
 	    for( const auto& e: E ) incl( e );
 	  }
 
@@ -277,7 +360,7 @@ namespace CoreAGI::Flat {
       unsigned i;
 
       Iter( const Set& X ): S{ X }, i{ 0 }{
-        if( S.data[i].key == NIHIL or S.data[i].del ) ++(*this);
+        if( S.data[i].key == NIHIL ) ++(*this);
       }
 
       bool operator != ( [[maybe_unused]]const Sentinel& S ) const { return i < SPACE; }
@@ -285,8 +368,8 @@ namespace CoreAGI::Flat {
       Iter& operator++ (){
         for(;;){
           i++;
-          if( i >= SPACE                              ) return *this;
-          if( S.data[i].key == NIHIL or S.data[i].del ) continue;
+          if( i >= SPACE               ) return *this;
+          if( S.data[i].key == NIHIL ) continue;
           return *this;
         }
       }
@@ -313,19 +396,29 @@ namespace CoreAGI::Flat {
   ______________________________________________________________________________________________________________________________
                                                                                                                               */
 
-  template< typename Val, unsigned CAPACITY, unsigned LOAD_FACTOR_PERCENT = 80 > class Map {
-
-    static constexpr unsigned SPACE = CAPACITY*100/LOAD_FACTOR_PERCENT;
-
+  template< typename Val, unsigned CAPACITY, unsigned LOAD_FACTOR_PERCENT = 80, bool POWER_OF_TWO = false,
+            unsigned KEY_BITS = PACKED > class Map {
+                                                                                                                              /*
+    Growable map: CAPACITY is the initial capacity only. When load factor or DIB limit is exceeded
+    the slot array is doubled and entries are migrated from the previous array gradually, MIGRATION slots
+    per incl/excl, so no single operation pays for the whole rehash. Until migration completes a key
+    may reside in either array. KEY_BITS is PACKED (24-bit keys) or WIDE (32-bit keys, DIB out of line).
+                                                                                                                              */
+    static_assert( LOAD_FACTOR_PERCENT > 0 and LOAD_FACTOR_PERCENT < 100 );
+    static_assert( KEY_BITS == PACKED or KEY_BITS == WIDE );
     static_assert( std::is_trivially_copyable< Key >::value );
     static_assert( std::is_trivially_copyable< Val >::value );
 
   public:
 
+    using Tag = Flat::Tag< KEY_BITS >;
+
+    static constexpr uint64_t LIMIT  { Tag::LIMIT       }; // :keys are less than LIMIT
+    static constexpr bool     OUTLINE{ KEY_BITS == WIDE }; // :DIB is kept in separate array
+
     struct Entry {
-      Key     key : 24;
-      uint8_t dib :  7;
-      bool    del :  1;
+      Key     key;
+      uint8_t dib;
       Val     val;
     };
 
@@ -337,7 +430,7 @@ namespace CoreAGI::Flat {
       EXHAUSTED = 0, // :not inserted because capacity exceeded
       INCLUDED  = 1, // :OK, included
       EXCLUDED  = 2, // :OK, excluded
-      RECOVERED = 3, // :inserted element that was deleted earlier
+      RECOVERED = 3, // :not used since deletion does not leave tombstones
       CONTAINED = 4, // :not inserted because already presented
       NOT_FOUND = 5, // :not excluded because not presented
       EMPTY_SET = 6  // :not excluded/included because empty set
@@ -357,65 +450,193 @@ namespace CoreAGI::Flat {
       return nullptr;
     }
 
-    static unsigned capacity(){ return CAPACITY;                                                      }
-    static unsigned memory  (){ return sizeof( Entry )*SPACE + sizeof( cardinal ) + sizeof( Entry* ); }
+                                                                                                                              /*
+    Number of slots of the previous array migrated per incl/excl; migration takes past.space/MIGRATION
+    operations, that is less than number of insertions which can exceed load factor again, so growth
+    never waits for migration:
+                                                                                                                              */
+    static constexpr unsigned MIGRATION{ std::max( 4u, 200/LOAD_FACTOR_PERCENT ) };
+
+    unsigned capacity () const { return now.space*LOAD_FACTOR_PERCENT/100;                                         }
+    unsigned migrating() const { return pending; } // :entries of the previous array not migrated yet
+    unsigned memory   () const { return ( sizeof( Tag ) + OUTLINE + sizeof( Val ) )*( now.space + past.space ) + sizeof( Map ); }
 
   private:
 
+    static constexpr unsigned DIB_LIMIT{ 8 }; // :growth criterion
+                                                                                                                              /*
+    Array of slots with Robin Hood placement; control words and values are kept in separate arrays,
+    so search touches (and compares by group) control words only; if OUTLINE, DIBs are kept in the
+    third array touched by insertion, deletion and probe sequences too long for group comparison:
+                                                                                                                              */
+    struct Table {
+
+      Tag*     tag    { nullptr }; // :control words (followed by GROUP vacant ones)
+      uint8_t* far    { nullptr }; // :DIBs if OUTLINE
+      Val*     val    { nullptr }; // :values
+      unsigned space  { 0       }; // :number of slots
+      unsigned shift  { 0       }; // :32 - log2( space ), used if POWER_OF_TWO
+      unsigned count  { 0       }; // :number of entries
+      unsigned reach  { 0       }; // :maximal DIB since allocation
+      bool     crowded{ false   }; // :DIB_LIMIT was reached by some insertion
+
+      static Table make( unsigned space ){
+                                                                                                                              /*
+        Zeroed memory from `calloc` is mapped lazily, so cost of touching large array is spread
+        over subsequent operations instead of being paid by the `incl` that triggered growth:
+                                                                                                                              */
+        Table T;
+        T.tag   = static_cast< Tag* >( calloc( space + GROUP, sizeof( Tag ) ) );
+        T.val   = static_cast< Val* >( calloc( space,         sizeof( Val ) ) );
+        T.space = space;
+        if constexpr( OUTLINE      ) T.far   = static_cast< uint8_t* >( calloc( space, 1 ) );
+        if constexpr( POWER_OF_TWO ) T.shift = 32 - unsigned( std::countr_zero( space ) );
+        assert( T.tag and T.val and ( T.far or not OUTLINE ) );
+        return T;
+      }
+
+      void release(){ free( tag ); free( far ); free( val ); *this = Table{}; }
+
+      uint8_t dib( unsigned i ) const {
+        if constexpr( OUTLINE ) return far[i];
+        else                    return tag[i].dib;
+      }
+
+      void set( unsigned i, Key key, uint8_t dib ){
+        if constexpr( OUTLINE ){ tag[i].key = key; far[i] = dib; }
+        else                   { tag[i] = Tag{ key, dib };       }
+      }
+
+      unsigned home( Key key ) const {
+        if constexpr( POWER_OF_TWO ) return uint32_t( key*PHI ) >> shift;
+        else                         return key % space;
+      }
+
+      unsigned next( unsigned i ) const { return ++i == space ? 0 : i; }
+
+      void prefetch( Key key ) const {
+        const unsigned i{ home( key ) };
+        __builtin_prefetch( tag + i );
+        __builtin_prefetch( val + i );
+      }
+
+      unsigned find( Key key ) const {
+                                                                                                                              /*
+        Returns position of `key` or `space` if not presented; search stops at vacant slot or at entry
+        that is closer to its initial bucket than `key` would be, so number of probes is bounded by DIB:
+                                                                                                                              */
+        if( count == 0 ) return space;
+        unsigned i{ home( key ) };
+        if constexpr( GROUP > 1 ){
+          if( reach < GROUP and i + reach < space ){ // :probe sequence does not wrap around
+            const unsigned k{ scan( tag + i, key, reach ) };
+            return k < GROUP ? i + k : space;
+          }
+        }
+        for( unsigned d = 0; ; d++ ){
+          const Key k{ tag[i].key };
+          if( k == key                ) return i;
+          if( k == 0 or dib( i ) < d ) return space;
+          i = next( i );
+        }
+      }
+
+      Note place( Key key, Val v ){
+        assert( count < space );
+        uint8_t d{ 0 }; // :DIB (distance to initial bucket) is zero initially
+        for( unsigned c = home( key ); ; c = next( c ) ){
+          if( tag[c].key == 0 ){ // Vacant slot, insert here
+            set( c, key, d );
+            val[c] = v;
+            reach  = std::max( reach, unsigned( d ) );
+            count++;
+            return INCLUDED;
+          }
+          if( tag[c].key == key ){ // Presented:
+            val[c] = v;
+            return CONTAINED;
+          }
+          if( dib( c ) < d ){ // To be swapped because it is rich.
+                                                                                                                              /*
+            Swap `key` and `tag[c]`, i.e. insert here but move current element to some another place
+                                                                                                                              */
+            const Key     k{ tag[c].key };
+            const uint8_t e{ dib( c )   };
+            set( c, key, d );
+            key = k;
+            d   = e;
+            std::swap( v, val[c] );
+            reach = std::max( reach, unsigned( dib( c ) ) );
+          }
+          assert( d < 255 );
+          if( ++d >= DIB_LIMIT ) crowded = true; //:the entry to be inserted goes away from ideal position
+        }
+      }
+
+      void erase( unsigned i ){
+                                                                                                                              /*
+        Backward shift deletion: shift following entries of the same cluster one position back
+        until vacant or well placed entry:
+                                                                                                                              */
+        for(;;){
+          const unsigned j{ next( i ) };
+          if( tag[j].key == 0 or dib( j ) == 0 ) break;
+          set( i, tag[j].key, dib( j ) - 1 );
+          val[i] = val[j];
+          i = j;
+        }
+        set( i, 0, 0 );
+        count--;
+      }
+
+    };//struct Table
+
 	  uint32_t cardinal;
-	  Entry*   data;
+	  Table    now;     // :actual slots
+	  Table    past;    // :slots before last growth, being migrated into `now`; empty if migration completed
+	  unsigned origin;  // :slot of `past` vacant at growth, where migration starts, so no cluster straddles it
+	  unsigned cursor;  // :number of slots of `past` visited from `origin`
+	  unsigned pending; // :entries of `past` not migrated yet
 
-	  Note incl_( Key key, const Val& val, unsigned depth = 0 ){
-      assert( key != NIHIL );
-	    assert( key < UINT24 );
-	    if( cardinal >= CAPACITY ) return EXHAUSTED;
-      unsigned i{ key % SPACE        }; // :desired position
-      Entry    e{ key, 0, false, val }; // :DIB (distance to initial bucket) is zero initially
-      for( unsigned c = i; ; c = ( c + 1 ) % SPACE ){
-		    if( data[c].key == 0 ){ // Vacant cell, insert here
-			    data[c] = e;
-			    cardinal++;
-			    return INCLUDED;
-		    }
-		    if( data[c].key == e.key ){ // Presented or deleted
-			    if( data[c].del ){ // Sometime was presented but deleted - just recovery:
-			      data[c].del = false;
-			      data[c].val = e.val;
-			      cardinal++;
-			      return RECOVERED;
-			    } else { // Presented:
-			      data[c].val = e.val;
-			      return CONTAINED;
-			    }
-			    break;
-		    }
-			  if( data[c].dib < e.dib ){ // To be swapped because it is rich.
-			                                                                                                                        /*
-			    Swap `e` and `data[c]`, i.e. insert here but move current element to some another place
-			                                                                                                                        */
-          std::swap( e, data[c] );
-        }//if
-        constexpr unsigned DIB_LIMIT{ 8 }; // :rehashing criterion
-        if( e.dib >= DIB_LIMIT ){ return rehash( e, depth ); }
-		    else e.dib++; //:the entry to be inserted goes away from ideal position gradually
-      }// for c
-		  return INCLUDED;
-	  }//incl
+    bool migrated( unsigned i ) const { return ( i + past.space - origin ) % past.space < cursor; } // :slot `i` of `past` is visited
 
-    Note rehash( Entry e, unsigned depth ){
+    unsigned remains( Key key ) const {
                                                                                                                               /*
-      Collect all currently presented elements into the temporary array E:
+      Position of not migrated `key` in `past` or past.space:
                                                                                                                               */
-      std::vector< Entry > E( cardinal );
-      unsigned n{ 0 };
-      for( unsigned i = 0; i < SPACE; i++ ) if( data[i].key != 0 and not data[i].del ) E[n++] = data[i];
-      clear();
-      for( unsigned i = 0; i < n; i++ ) assert( incl_( E[i].key, E[i].val, depth + 1 ) );
+      if( pending == 0 ) return past.space;
+      const unsigned i{ past.find( key ) };
+      return i < past.space and not migrated( i ) ? i : past.space;
+    }
+
+    void migrate( unsigned budget ){
                                                                                                                               /*
-      Finally add `elem`:
+      Copy entries of `past` into `now` visiting no more than `budget` slots. Visited entries are left
+      in place (search ignores them), so copying never shifts clusters of `past` and it stays valid Robin
+      Hood table: not visited entries can be searched/excluded until migrated. Backward shift of `excl`
+      moves entries of a cluster that follow excluded one, i.e. not visited ones only:
                                                                                                                               */
-      if( e.key and not e.del ) assert( incl_( e.key, e.val, depth + 1 ) == INCLUDED );
-      return INCLUDED;
+      for( ; pending > 0 and budget > 0; budget-- ){
+        assert( cursor < past.space );
+        const unsigned i{ ( origin + cursor++ ) % past.space };
+        if( past.tag[i].key == 0 ) continue;
+        now.place( past.tag[i].key, past.val[i] );
+        pending--;
+      }
+      if( past.tag and pending == 0 ) past.release();
+    }
+
+    void grow(){
+                                                                                                                              /*
+      Double the slot array; existing entries remain in `past` and will be migrated gradually:
+                                                                                                                              */
+      assert( pending == 0 ); // :previous migration is completed, see MIGRATION
+      past    = now;
+      now     = Table::make( 2*past.space );
+      origin  = 0;
+      while( past.tag[ origin ].key != 0 ) origin++; // :load factor is below 100%, so vacant slot exists
+      cursor  = 0;
+      pending = past.count;
     }
 
   public:
@@ -423,14 +644,14 @@ namespace CoreAGI::Flat {
 	  std::string content() const {
 	    std::stringstream out;
 	    out << std::setw( 4 ) << cardinal << " {";
-	    for( unsigned i = 0; i < SPACE; i++ ){
-	      Entry& e{ data[i] };
-	      if( e.key == 0 ) out << "  empty ";
-	      else {
-	        if( e.del ) out << " ("; else out << "  ";
-	        out << std::setw( 3 ) << e.key;
-	        if( e.del ) out << ")"; else out << "`";
-	        out << unsigned( e.dib );
+	    for( const Table* T: { &now, &past } ){
+	      if( T == &past and not past.tag ) break;
+	      if( T == &past ) out << " |";
+	      for( unsigned i = 0; i < T->space; i++ ){
+	        const Key key{ T->tag[i].key };
+	        if     ( key == 0                     ) out << "  empty ";
+	        else if( T == &past and migrated( i ) ) out << "  moved ";
+	        else           out << "  " << std::setw( 3 ) << key << '`' << unsigned( T->dib( i ) );
 	      }
 	    }
 	    out << " }";
@@ -439,101 +660,172 @@ namespace CoreAGI::Flat {
 
     void clear(){
       cardinal = 0;
-	    memset( data, 0, sizeof( Entry )*SPACE );
+      pending  = 0;
+      past.release();
+	    memset( now.tag, 0, sizeof( Tag )*now.space );
+	    if constexpr( OUTLINE ) memset( now.far, 0, now.space );
+	    now.count   = 0;
+	    now.reach   = 0;
+	    now.crowded = false;
     }
 
-	  Map(): cardinal{ 0 }, data{ new Entry[ SPACE ] }{
-	    assert( data );
-	    memset( data, 0, sizeof( Entry )*SPACE );
-	  }
+                                                                                                                              /*
+    Slot arrays as is (for binary snapshot); pending migration is completed first, so all entries
+    reside in the returned arrays; DIBs kept out of line are not included (`assign` restores them):
+                                                                                                                              */
+    std::span< const Tag > tags(){ migrate( past.space ); return std::span< const Tag >( now.tag, now.space ); }
+    std::span< const Val > vals(){ migrate( past.space ); return std::span< const Val >( now.val, now.space ); }
+
+    void assign( std::span< const Tag > tag, std::span< const Val > val ){
+                                                                                                                              /*
+      Replace content by slot arrays obtained by `tags()` and `vals()` of the map of the same type:
+                                                                                                                              */
+      assert( tag.size() == val.size() and tag.size() > 1 );
+      if constexpr( POWER_OF_TWO ) assert( std::has_single_bit( tag.size() ) );
+      now.release();
+      past.release();
+      now = Table::make( tag.size() );
+      memcpy( now.tag, tag.data(), tag.size_bytes() );
+      memcpy( now.val, val.data(), val.size_bytes() );
+      for( unsigned i = 0; i < now.space; i++ ){
+        const Key key{ now.tag[i].key };
+        if( key == 0 ) continue;
+        if constexpr( OUTLINE ){
+          const unsigned h{ now.home( key ) };
+          now.far[i] = uint8_t( i >= h ? i - h : i + now.space - h );
+        }
+        now.count++;
+        now.reach = std::max( now.reach, unsigned( now.dib( i ) ) );
+      }
+      cardinal = now.count;
+      pending  = 0;
+    }
+
+	  Map(): cardinal{ 0 }, now{ Table::make( Layout< CAPACITY, LOAD_FACTOR_PERCENT, POWER_OF_TWO >::SPACE ) }, past{}, origin{ 0 }, cursor{ 0 }, pending{ 0 }{}
 
 	  Map( const Map& ) = delete;
 	  Map& operator = ( const Map& ) = delete;
 
-	 ~Map(){ delete[] data; }
+	 ~Map(){ now.release(); past.release(); }
 
     bool vacant( Key key, unsigned maxDistance = 0 ) const {
       assert( key != NIHIL );
-	    assert( key < UINT24 );
- 	    if( cardinal >= CAPACITY ) return false;
-      const unsigned desiredPosition{ key % SPACE }; // :desired position
+	    assert( key < LIMIT );
+      const unsigned desiredPosition{ now.home( key ) }; // :desired position
       unsigned distance{ 0 };
       unsigned i{ desiredPosition };
-	    while( not( data[i].key == NIHIL or data[i].del ) ){
-		    i = ( i + 1 ) % SPACE;
+	    while( now.tag[i].key != NIHIL ){
+		    i = now.next( i );
 		    if( ++distance > maxDistance ) return false; // :too distant
 		    if( i == desiredPosition     ) return false; // :no vacant found in full loop
       }
       return true;
     }
 
-	  Note incl( Key elem, const Val& val = Val{} ){ return incl_( elem, val ); }
+	  Note incl( Key key, const Val& val = Val{} ){
+      assert( key != NIHIL );
+	    assert( key < LIMIT );
+	    migrate( MIGRATION );
+	    const unsigned i{ remains( key ) };
+	    if( i < past.space ){ past.val[i] = val; return CONTAINED; }
+	    const Note note{ now.place( key, val ) };
+	    if( note != INCLUDED ) return note;
+	    cardinal++;
+                                                                                                                              /*
+      Grow if load factor exceeded or if probe sequences become too long while load is not too small
+      (otherwise just unlucky keys could blow up the table); the latter waits for completion of the
+      current migration:
+                                                                                                                              */
+	    const unsigned load{ 100*now.count };
+	    if( load > now.space*LOAD_FACTOR_PERCENT ) grow();
+	    else if( now.crowded and pending == 0 and 2*load > now.space*LOAD_FACTOR_PERCENT ) grow();
+	    return INCLUDED;
+	  }
 
     Val* get( const Key key ){
-	    assert( key < UINT24 );
-	    if( cardinal == 0  ) return nullptr;
-      unsigned i{ key % SPACE }; // :desired position
-	    while( data[i].key != key ){
-		    i = ( i + 1 ) % SPACE;
-		    if( i == key % SPACE ) return nullptr;	// :full loop performed but not found
-      }
-      assert( i < SPACE );
+	    assert( key < LIMIT );
+      if( key == NIHIL ) return nullptr;
+      unsigned i{ now.find( key ) };
+      if( i < now.space ) return &( now.val[i] );
+      i = remains( key );
+	    return i < past.space ? &( past.val[i] ) : nullptr;
+    }
+
+    const Val* get( const Key key ) const { return const_cast< Map* >( this )->get( key ); }
+
+    void getBatch( std::span< const Key > keys, std::span< Val* > out ){
                                                                                                                               /*
-      Key found, but it may be deleted, so result depends on date[.].del:
+      Look up group of keys; slots of the key AHEAD positions forward are prefetched,
+      so cache misses of independent lookups overlap instead of being paid one by one:
                                                                                                                               */
-	    return data[i].del ? nullptr : &( data[i].val );
+      assert( out.size() >= keys.size() );
+      constexpr size_t AHEAD{ 8           };
+      const     size_t n    { keys.size() };
+      for( size_t i = 0; i < std::min( AHEAD, n ); i++ ) now.prefetch( keys[i] );
+      for( size_t i = 0; i < n; i++ ){
+        if( i + AHEAD < n ) now.prefetch( keys[ i + AHEAD ] );
+        out[i] = get( keys[i] );
+      }
     }
 
-    const Val* get( const Key key ) const {
-	    assert( key < UINT24 );
-	    if( cardinal == 0  ) return nullptr;
-      unsigned i{ key % SPACE }; // :desired position
-	    while( data[i].key != key ){
-		    i = ( i + 1 ) % SPACE;
-		    if( i == key % SPACE ) return nullptr;	// :full loop performed but not found
-      }
-      assert( i < SPACE );
+    void build( std::span< const std::pair< Key, Val > > items ){
                                                                                                                               /*
-      Key found, but it may be deleted, so result depends on date[.].del:
+      Replace content by `items` (keys must be distinct). Items are ordered by initial bucket
+      (counting sort), so Robin Hood placement in that order needs no swaps and fills slots
+      sequentially; only items that wrap around the end of the array are placed regular way:
                                                                                                                               */
-	    return data[i].del ? nullptr : &( data[i].val );
+      clear();
+      unsigned space{ now.space };
+      while( 100*items.size() > size_t( space )*LOAD_FACTOR_PERCENT ) space *= 2;
+      if( space != now.space ){ now.release(); now = Table::make( space ); }
+      std::vector< unsigned > first( space + 1, 0 ); // :first[h] is position of bucket h in `order`
+      for( const auto& item: items ) first[ now.home( item.first ) + 1 ]++;
+      for( unsigned h = 0; h < space; h++ ) first[ h + 1 ] += first[ h ];
+      std::vector< unsigned > order( items.size() );
+      for( unsigned i = 0; i < items.size(); i++ ) order[ first[ now.home( items[i].first ) ]++ ] = i;
+      std::vector< unsigned > wrapped;
+      unsigned pos{ 0 };
+      for( const unsigned i: order ){
+        const auto& [ key, val ]{ items[i] };
+        assert( key != NIHIL );
+        assert( key <  LIMIT );
+        const unsigned h{ now.home( key ) };
+        pos = std::max( pos, h );
+        if( pos >= space ){ wrapped.push_back( i ); continue; }
+        const unsigned dib{ pos - h };
+        assert( dib < 255 );
+        now.set( pos, key, uint8_t( dib ) );
+        now.val[ pos ] = val;
+        now.reach      = std::max( now.reach, dib );
+        if( dib >= DIB_LIMIT ) now.crowded = true;
+        now.count++;
+        pos++;
+      }
+      for( const unsigned i: wrapped ) now.place( items[i].first, items[i].second );
+      cardinal = now.count;
     }
 
     bool contains( const Elem elem ) const {
 	    assert( elem != NIHIL );
-	    assert( elem < UINT24 );
-	    if( cardinal == 0  ) return false;
-      unsigned i{ elem % SPACE };
-	    while( data[i].key != elem ){
-		    i = ( i + 1 ) % SPACE;
-		    if( i == elem % SPACE ) return false;	// :not Found, vacant call reached
-      }
-                                                                                                                              /*
-      Key found, but it may be deleted, so result depends on date[.].del:
-                                                                                                                              */
-	    return not data[i].del;
+	    return get( elem ) != nullptr;
     }
 
     Note excl( const Key elem ){
-	    assert( elem < UINT24 );
+	    assert( elem < LIMIT );
 	    if( elem == NIHIL ) return NOT_FOUND;
 	    if( cardinal == 0 ) return EMPTY_SET;
-      unsigned i{ elem % SPACE };
-	    while( data[i].key != elem ){
-		    i = ( i + 1 ) % SPACE;
-		    if( i == elem % SPACE ){
-		      return NOT_FOUND;	// :not Found
-		    }
-      }
-                                                                                                                              /*
-      Key found, mark it as deleted:
-                                                                                                                              */
-      if( not data[i].del ){
-        data[i].del = true;
-        cardinal--;
-        return EXCLUDED;
+	    migrate( MIGRATION );
+      unsigned i{ now.find( elem ) };
+      if( i < now.space ){
+        now.erase( i );
+      } else {
+        i = remains( elem );
+        if( i >= past.space ) return NOT_FOUND;
+        past.erase( i );
+        pending--;
       }
-      return NOT_FOUND; // :the item has already been deleted earlier
+      cardinal--;
+      return EXCLUDED;
     }
 
 	  explicit operator bool() const{ return cardinal > 0; }
@@ -549,24 +841,29 @@ namespace CoreAGI::Flat {
     struct Iter {
 
       const Map& S;
-      unsigned   i;
+      unsigned   i; // :position in `now` followed by `past`
+
+      Key        key( unsigned k ) const { return k < S.now.space ? S.now.tag[k].key : S.past.tag[ k - S.now.space ].key; }
+      uint8_t    dib( unsigned k ) const { return k < S.now.space ? S.now.dib( k )   : S.past.dib( k - S.now.space );   }
+      const Val& val( unsigned k ) const { return k < S.now.space ? S.now.val[k]     : S.past.val[ k - S.now.space ];     }
+      bool       live( unsigned k ) const { return key( k ) != NIHIL and ( k < S.now.space or not S.migrated( k - S.now.space ) ); }
 
       Iter( const Map& X ): S{ X }, i{ 0 }{
-        if( S.data[i].key == NIHIL or S.data[i].del ) ++(*this);
+        if( not live( i ) ) ++(*this);
       }
 
-      bool operator != ( const Sentinel& ) const { return i < SPACE; }
+      bool operator != ( const Sentinel& ) const { return i < S.now.space + S.past.space; }
 
       Iter& operator++ (){
         for(;;){
           i++;
-          if( i >= SPACE                              ) return *this;
-          if( S.data[i].key == NIHIL or S.data[i].del ) continue;
+          if( i >= S.now.space + S.past.space ) return *this;
+          if( not live( i )                    ) continue;
           return *this;
         }
       }
 
-      const Entry& operator* (){ return S.data[i]; }
+      Entry operator* (){ return Entry{ key( i ), dib( i ), val( i ) }; }
 
     };//struct Iter
 
@@ -576,9 +873,11 @@ namespace CoreAGI::Flat {
 	  double averageProbeCount() const {
 	    unsigned num{ 0   };
 		  double   sum{ 0.0 };
-		  for( unsigned i = 0; i < SPACE; ++i ){
-			  unsigned dib = data[i].dib;
-		  	if( dib > 0 ){ num++, sum += dib;	}
+		  for( const Table* T: { &now, &past } ){
+		    for( unsigned i = 0; i < T->space; ++i ){
+			    unsigned dib = T->tag[i].key and not ( T == &past and migrated( i ) ) ? T->dib( i ) : 0;
+		  	  if( dib > 0 ){ num++, sum += dib;	}
+	  	  }
 	  	}
 		  return num ? sum/num : 0.0;
 	  }
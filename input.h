@@ -0,0 +1,97 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Input source: regular file is memory mapped (and read sequentially ahead by kernel),
+ so its content is handed out as contiguous byte ranges without copying; pipes, stdin
+ and files that can`t be mapped are read by large `read()` blocks.
+
+ 2021.03.12
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#ifndef INPUT_H_INCLUDED
+#define INPUT_H_INCLUDED
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace CoreAGI {
+
+  class Source {
+
+    int                 fd;     // :file descriptor or -1
+    const char*         map;    // :mapped file content or nullptr
+    size_t              size;   // :size of mapped content
+    size_t              pos;    // :next byte of mapped content
+    size_t              block;  // :max size of the range returned by `next()`
+    std::vector< char > buffer; // :used if file is not mapped
+
+  public:
+                                                                                                                              /*
+    Open `path`; nullptr or "-" means stdin:
+                                                                                                                              */
+    Source( const char* path, size_t block ): fd{ -1 }, map{ nullptr }, size{ 0 }, pos{ 0 }, block{ block }, buffer{}{
+      assert( block > 0 );
+      const bool stdinput{ path == nullptr or strcmp( path, "-" ) == 0 };
+      fd = stdinput ? STDIN_FILENO : open( path, O_RDONLY );
+      if( fd < 0 ) return;
+      struct stat info;
+      if( fstat( fd, &info ) == 0 and S_ISREG( info.st_mode ) and info.st_size > 0 ){
+        void* m{ mmap( nullptr, size_t( info.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 ) };
+        if( m != MAP_FAILED ){
+          madvise( m, size_t( info.st_size ), MADV_SEQUENTIAL );
+          map  = static_cast< const char* >( m );
+          size = size_t( info.st_size );
+          return;
+        }
+      }
+      buffer.resize( block ); // :fallback to `read()`
+    }
+
+    Source( const Source& ) = delete;
+    Source& operator = ( const Source& ) = delete;
+
+   ~Source(){
+      if( map ) munmap( const_cast< char* >( map ), size );
+      if( fd > STDIN_FILENO ) close( fd );
+    }
+
+    explicit operator bool() const { return fd >= 0; }
+
+    bool mapped() const { return map != nullptr; }
+                                                                                                                              /*
+    Returns next range of at most `block` bytes; empty range means end of input (or error):
+                                                                                                                              */
+    std::span< const char > next(){
+      if( map ){
+        const size_t n{ std::min( block, size - pos ) };
+        const std::span< const char > range( map + pos, n );
+        pos += n;
+        return range;
+      }
+      if( fd < 0 ) return {};
+      for(;;){
+        const ssize_t n{ read( fd, buffer.data(), buffer.size() ) };
+        if( n < 0 and errno == EINTR ) continue;
+        if( n <= 0 ) return {};
+        return std::span< const char >( buffer.data(), size_t( n ) );
+      }
+    }
+
+  };//class Source
+
+}//namespace CoreAGI
+
+#endif // INPUT_H_INCLUDED
@@ -0,0 +1,153 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Single-producer/single-consumer pipeline of batches: producer thread fills
+ a batch in place and publishes it, consumer thread processes published
+ batches in order and releases them. Ring has DEPTH batch slots; producer
+ waits when all of them are published but not released yet (backpressure),
+ consumer waits when nothing is published. Indices of the producer and the
+ consumer are kept in separate cache lines together with a cached copy of
+ the opposite index, so the shared lines are touched once per batch only.
+
+ 2021.03.28
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#ifndef PIPELINE_H_INCLUDED
+#define PIPELINE_H_INCLUDED
+
+#include <cassert>
+#include <cstdint>
+
+#include <atomic>
+#include <bit>
+#include <new>
+#include <span>
+#include <thread>
+#include <vector>
+
+#if defined( __SSE2__ )
+  #include <emmintrin.h>
+#endif
+
+namespace CoreAGI {
+
+  template< typename Item, size_t BATCH, unsigned DEPTH = 8 > class Pipeline {
+
+    static_assert( std::has_single_bit( DEPTH ) );
+    static_assert( BATCH > 0 );
+
+    static constexpr size_t LINE{ 64 }; // :cache line size
+    static constexpr unsigned SPIN{ 64 }; // :busy wait iterations before yielding
+
+    struct alignas( LINE ) Side {
+      std::atomic< uint64_t > index{ 0 }; // :own index: published (producer) or released (consumer) batches
+      uint64_t                other{ 0 }; // :cached opposite index
+      uint64_t                waits{ 0 }; // :number of times the side had to wait
+      uint64_t                items{ 0 }; // :number of items passed
+    };
+
+    std::vector< Item >   item;            // :DEPTH slots of BATCH items
+    size_t                size[ DEPTH ];   // :number of items in the published batch
+    Side                  producer;
+    Side                  consumer;
+    alignas( LINE ) std::atomic< bool > closed;
+
+    static void pause( unsigned& spin ){
+      if( ++spin < SPIN ){
+#if defined( __SSE2__ )
+        _mm_pause();
+#endif
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+  public:
+
+    Pipeline(): item( BATCH*DEPTH ), size{}, producer{}, consumer{}, closed{ false }{}
+
+    Pipeline( const Pipeline& ) = delete;
+    Pipeline& operator = ( const Pipeline& ) = delete;
+                                                                                                                              /*
+    Producer side:
+                                                                                                                              */
+    std::span< Item > acquire(){
+                                                                                                                              /*
+      Returns vacant batch slot to be filled; waits while all slots are occupied:
+                                                                                                                              */
+      const uint64_t h{ producer.index.load( std::memory_order_relaxed ) };
+      if( h - producer.other == DEPTH ){
+        unsigned spin{ 0 };
+        producer.other = consumer.index.load( std::memory_order_acquire );
+        if( h - producer.other == DEPTH ) producer.waits++;
+        while( h - producer.other == DEPTH ){
+          pause( spin );
+          producer.other = consumer.index.load( std::memory_order_acquire );
+        }
+      }
+      return std::span< Item >( item.data() + ( h % DEPTH )*BATCH, BATCH );
+    }
+
+    void publish( size_t n ){
+                                                                                                                              /*
+      Publish first `n` items of the slot returned by `acquire`:
+                                                                                                                              */
+      assert( n <= BATCH );
+      const uint64_t h{ producer.index.load( std::memory_order_relaxed ) };
+      size[ h % DEPTH ] = n;
+      producer.items   += n;
+      producer.index.store( h + 1, std::memory_order_release );
+    }
+
+    void close(){ closed.store( true, std::memory_order_release ); } // :no more batches
+                                                                                                                              /*
+    Consumer side:
+                                                                                                                              */
+    bool next( std::span< const Item >& batch ){
+                                                                                                                              /*
+      Get the oldest published batch (it may be empty); waits if there is no one; returns `false`
+      if pipeline is closed and all batches are consumed:
+                                                                                                                              */
+      const uint64_t t{ consumer.index.load( std::memory_order_relaxed ) };
+      if( consumer.other == t ){
+        unsigned spin{ 0 };
+        consumer.other = producer.index.load( std::memory_order_acquire );
+        if( consumer.other == t ) consumer.waits++;
+        while( consumer.other == t ){
+          if( closed.load( std::memory_order_acquire ) ){
+            consumer.other = producer.index.load( std::memory_order_acquire );
+            if( consumer.other == t ) return false;
+            break;
+          }
+          pause( spin );
+          consumer.other = producer.index.load( std::memory_order_acquire );
+        }
+      }
+      batch = std::span< const Item >( item.data() + ( t % DEPTH )*BATCH, size[ t % DEPTH ] );
+      return true;
+    }
+
+    void release(){
+                                                                                                                              /*
+      Return batch obtained by `next` (returned `true`) to the producer:
+                                                                                                                              */
+      const uint64_t t{ consumer.index.load( std::memory_order_relaxed ) };
+      consumer.items += size[ t % DEPTH ];
+      consumer.index.store( t + 1, std::memory_order_release );
+    }
+                                                                                                                              /*
+    Counters (read by the side that owns them or after both threads finished):
+                                                                                                                              */
+    uint64_t batches      () const { return producer.index.load(); }
+    uint64_t items        () const { return producer.items;        }
+    uint64_t producerWaits() const { return producer.waits;        } // :producer found ring full
+    uint64_t consumerWaits() const { return consumer.waits;        } // :consumer found ring empty
+
+  };//class Pipeline
+
+}//namespace CoreAGI
+
+#endif // PIPELINE_H_INCLUDED
@@ -7,6 +7,38 @@
  Queue with optional lock for push and/or pull.
  Based on circular buffer.
 
+ Concurrency: `push`, `pushN`, `pull`, `pullN` and the observers `size`/`empty` are
+ safe to call from producer and consumer threads according to NATURE:
+
+   LOCK_FREE (SPSC)  one producer thread, one consumer thread, no locks;
+   MPSC              any number of producer threads, one consumer thread, no locks;
+   LOCK_PUSH         producers serialized by mutex, one consumer thread without lock;
+   LOCK_PULL         one producer thread without lock, consumers serialized by mutex;
+   LOCK_FULL         both sides serialized by mutex.
+
+ Elements are published by release store of the `pushed` counter and consumed slots
+ are returned by release store of `pulled`; opposite side reads the counter with acquire.
+ Producer and consumer counters live in separate cache lines, each side keeps a cached
+ copy of the opposite counter and reloads it only when the cached value says the queue is
+ full (empty). MPSC producers claim slots by CAS on `claimed`, fill them and publish in
+ claim order (a producer waits for the preceding claims to be published).
+ Counters are 64-bit and never wrap; element with counter value `c` is stored in `seq[ c % CAPACITY ]`,
+ that is reduced to mask if CAPACITY is power of two (recommended).
+
+ If CAPACITY is DYNAMIC, capacity is given to constructor and the ring is allocated from
+ anonymous memory mapping (optionally backed by huge pages) that is zero and touched lazily,
+ so capacity of hundreds of millions of elements costs nothing until used; Elem must be
+ trivially copyable in this case, slots out of the queue are never read as elements.
+
+ All the other methods (`tamp`, `pop`, `compact`, `clear`, `assign`, element access) are
+ owner operations: they lock mutex in LOCK_* natures, but are not synchronized with the
+ lock-free side, so must not run concurrently with it.
+
+ OCCUPANCY adds bitmap of presented (not NIHIL) elements, so holes are skipped by whole words:
+ `adjacent`, `following`, `preceding`, `process` do not visit holes one by one, and `at( k )`
+ finds k-th presented element by rank/select. Holes must be made by `punch` or `move` (not
+ by writing NIHIL through `ref`). Bitmap is not synchronized, so such queue is used by one thread.
+
  2021.02.20
 ________________________________________________________________________________________________________________________________
                                                                                                                               */
@@ -14,82 +46,287 @@ ________________________________________________________________________________
 #define QUEUE_H_INCLUDED
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 
+#include <algorithm>
 #include <atomic>
-#include <limits>
+#include <bit>
 #include <mutex>
+#include <span>
 #include <sstream>
+#include <thread>
 #include <vector>
+#include <type_traits>
 #include <utility>  // std::pair
 
+#include "arena.h"
+#include "bitmap.h"
+#include "def.h"
+
+#if defined( __SSE2__ )
+  #include <emmintrin.h>
+#endif
+
 namespace CoreAGI {
 
-  enum class QueueNature { LOCK_FREE, LOCK_PUSH, LOCK_PULL, LOCK_FULL };
+  enum class QueueNature { LOCK_FREE, LOCK_PUSH, LOCK_PULL, LOCK_FULL, MPSC, SPSC = LOCK_FREE };
+
+  template< typename Elem, unsigned CAPACITY, QueueNature NATURE = QueueNature::LOCK_FREE, bool OCCUPANCY = false > class Queue {
+
+    static_assert( not OCCUPANCY or NATURE == QueueNature::LOCK_FREE, "Occupancy bitmap is not synchronized" );
+
+    using Unsigned = uint64_t;
+    using Counter  = std::atomic< Unsigned >;
+
+    static constexpr size_t LINE     { 64 }; // :cache line size
+    static constexpr bool   FIXED    { CAPACITY != DYNAMIC                                                  }; // :capacity is known at compile time
+    static constexpr bool   RING     { std::has_single_bit( CAPACITY ) }; // :power of two capacity: indices are masked counters
+    static constexpr bool   MULTIPUSH{ NATURE == QueueNature::MPSC                                         };
+    static constexpr bool   LOCKPUSH { NATURE == QueueNature::LOCK_PUSH or NATURE == QueueNature::LOCK_FULL };
+    static constexpr bool   LOCKPULL { NATURE == QueueNature::LOCK_PULL or NATURE == QueueNature::LOCK_FULL };
+    static constexpr bool   LOCKED   { LOCKPUSH or LOCKPULL                                                 };
+
+    unsigned slot( Unsigned counter ) const { // :index in `seq` of the element with given counter value
+      if constexpr( RING  ) return unsigned( counter & ( CAPACITY - 1 ) );
+      if constexpr( FIXED ) return unsigned( counter % CAPACITY         );
+      return unsigned( MASK ? counter & MASK : counter % SPACE );
+    }
+
+    class Hold {
+                                                                                                                              /*
+      Scoped lock that is compiled out when not required:
+                                                                                                                              */
+      std::mutex* m;
+    public:
+      Hold( std::mutex& mutex, bool lock ): m{ lock ? &mutex : nullptr }{ if( m ) m->lock(); }
+     ~Hold(){ if( m ) m->unlock(); }
+      Hold( const Hold& ) = delete;
+      Hold& operator = ( const Hold& ) = delete;
+    };
+
+    struct None { None( unsigned = 0 ){} };
+
+    const Elem                  NIHIL;
+    const unsigned              SPACE;      // :actual capacity
+    const Unsigned              MASK;       // :SPACE - 1 if SPACE is power of two, otherwise 0
+    alignas( LINE ) Counter     pushed;     // :producer side: published elements
+                    Counter     claimed;    // :MPSC: slots claimed by producers, >= pushed
+                    Unsigned    pulledSeen; // :producer`s copy of `pulled`, not greater than actual
+    alignas( LINE ) Counter     pulled;     // :consumer side: released slots
+                    Unsigned    pushedSeen; // :consumer`s copy of `pushed`, not greater than actual
+    [[no_unique_address]] std::conditional_t< FIXED, None, Arena > region; // :memory of the dynamic ring
+    alignas( LINE ) std::conditional_t< FIXED, Elem[ FIXED ? CAPACITY : 1 ], Elem* > seq;
+    mutable std::mutex          mutex;
+
+    [[no_unique_address]] std::conditional_t< OCCUPANCY, Bitmap< CAPACITY >, None > live; // :presented elements
+
+    static void pause( unsigned& spin ){
+      if( ++spin < 64 ){
+#if defined( __SSE2__ )
+        _mm_pause();
+#endif
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    void sync(){
+                                                                                                                              /*
+      Owner operation changed counters: cached copies and claims follow them:
+                                                                                                                              */
+      pulledSeen = pulled.load( std::memory_order_relaxed );
+      pushedSeen = pushed.load( std::memory_order_relaxed );
+      if constexpr( MULTIPUSH ) claimed.store( pushedSeen, std::memory_order_relaxed );
+    }
+
+    void occupy( Unsigned from, Unsigned to ){ // :mark elements [ from, to ) (by counter) presented
+      if constexpr( OCCUPANCY ) for( Unsigned c = from; c < to; c++ ) live.set( slot( c ) );
+    }
+
+    void vacate( Unsigned from, Unsigned to ){ // :mark elements [ from, to ) (by counter) out of queue
+      if constexpr( OCCUPANCY ) for( Unsigned c = from; c < to; c++ ) live.reset( slot( c ) );
+    }
+
+    void survey(){ // :rebuild occupancy bitmap
+      if constexpr( OCCUPANCY ){
+        const unsigned n{ size() };
+        live.assign( [&]( unsigned i ){ return order( i ) < n and seq[i] != NIHIL; } );
+      }
+    }
 
-  template< typename Elem, unsigned CAPACITY, QueueNature NATURE = QueueNature::LOCK_FREE > class Queue {
+    void put( Unsigned from, const Elem* src, size_t n ){ // :copy into ring, at most two segments
+      const size_t i{ slot( from )                          };
+      const size_t k{ std::min( n, size_t( capacity() ) - i ) };
+      std::copy_n( src,     k,     seq + i );
+      std::copy_n( src + k, n - k, seq     );
+    }
 
-    using Unsigned = unsigned;
-    using Guard    = std::lock_guard< std::mutex >;
+    void get( Unsigned from, Elem* dst, size_t n ) const { // :copy from ring, at most two segments
+      const size_t i{ slot( from )                          };
+      const size_t k{ std::min( n, size_t( capacity() ) - i ) };
+      std::copy_n( seq + i, k,     dst     );
+      std::copy_n( seq,     n - k, dst + k );
+    }
 
-    const Elem              NIHIL;
-    std::atomic< Unsigned > pushed;
-    std::atomic< Unsigned > pulled;
-    Elem                    seq[ CAPACITY ];
-    std::mutex              mutex;
+    size_t room( size_t n ){
+                                                                                                                              /*
+      Producer (single or holding lock): number of slots available for `n` elements:
+                                                                                                                              */
+      const Unsigned p{ pushed.load( std::memory_order_relaxed ) };
+      if( p - pulledSeen + n > capacity() ) pulledSeen = pulled.load( std::memory_order_acquire );
+      return std::min( n, size_t( capacity() - ( p - pulledSeen ) ) );
+    }
 
-    static constexpr Unsigned MAX  { std::numeric_limits< Unsigned >::max() };
-    static constexpr Unsigned LIMIT{ MAX - ( MAX % CAPACITY ) - CAPACITY    };
-    static_assert( LIMIT % CAPACITY == 0   );
-    static_assert( LIMIT + CAPACITY <  MAX );
+    size_t stock( size_t n ){
+                                                                                                                              /*
+      Consumer (single or holding lock): number of elements available for `n` requested:
+                                                                                                                              */
+      const Unsigned q{ pulled.load( std::memory_order_relaxed ) };
+      if( pushedSeen < q + n ) pushedSeen = pushed.load( std::memory_order_acquire );
+      return pushedSeen > q ? std::min( n, size_t( pushedSeen - q ) ) : 0;
+    }
 
-    static unsigned location( unsigned pushed, unsigned pulled, int i ){  // [+] 2020.05.06
+    size_t claim( size_t n, Unsigned& from ){
+                                                                                                                              /*
+      MPSC producer: reserve up to `n` slots starting from `from`:
+                                                                                                                              */
+      Unsigned c{ claimed.load( std::memory_order_relaxed ) };
+      for(;;){
+        const Unsigned q{ pulled.load( std::memory_order_acquire ) };
+        if( q > c ){ c = claimed.load( std::memory_order_relaxed ); continue; } // :stale claim counter
+        const size_t k{ std::min( n, size_t( capacity() - ( c - q ) ) ) };
+        if( k == 0 ) return 0;
+        if( not claimed.compare_exchange_weak( c, c + k, std::memory_order_relaxed, std::memory_order_relaxed ) ) continue; // :`c` reloaded
+        from = c;
+        return k;
+      }
+    }
+
+    void publish( Unsigned from, size_t n ){
+                                                                                                                              /*
+      MPSC producer: publish filled slots after all preceding claims are published:
+                                                                                                                              */
+      unsigned spin{ 0 };
+      while( pushed.load( std::memory_order_acquire ) != from ) pause( spin );
+      pushed.store( from + n, std::memory_order_release );
+    }
+
+    unsigned location( Unsigned pushed, Unsigned pulled, int i ){  // [+] 2020.05.06
                                                                                                                               /*
       Caclculates index in the `seq` array of element by distance from the oldest presented
       element (which will be pulled at this moment) in case when `distance` >= 0 or from the
       last inserted element if distance < 0.
       So index(-1 ) refers last pushed element,
          index( 0 ) refers oldes presented element.
-      If argument refers nonexisting element, returns unsigned(-1).
-                                                                                                                              */
-      const int SIZE{ int( pushed ) - int( pulled ) };
-      unsigned result;
-      if( i >= 0 ){ // Enumerate from first:
-        while( i >= SIZE ) i -= CAPACITY;
-        result = ( pulled + i ) % CAPACITY;
-      } else { // Enumerate from last:
-        while( abs( i ) > SIZE ) i -= CAPACITY;
-        result = ( CAPACITY + pushed + i ) % CAPACITY;
-      }
-      assert( result < CAPACITY );
-      return result;
+      Distance is taken modulo capacity, so result is always valid index:
+                                                                                                                              */
+      if( i >= 0 ) return slot( pulled + unsigned( i ) );                                // :enumerate from first
+      return slot( pushed + capacity() - ( unsigned( -int64_t( i ) ) % capacity() ) );       // :enumerate from last
     }
 
     Elem* element( unsigned i ){
-      assert( i < CAPACITY );
+      assert( i < capacity() );
       return seq[ i ];
     };
 
   public:
 
-    Queue( const Elem& nihil = Elem{} ): NIHIL{ nihil }, pushed{ 0 }, pulled{ 0 }, seq{ NIHIL }, mutex{}{}
+    Queue( const Elem& nihil = Elem{} ) requires( FIXED ):
+      NIHIL     { nihil                               },
+      SPACE     { CAPACITY                            },
+      MASK      { RING ? CAPACITY - 1 : 0             },
+      pushed    { 0                                   },
+      claimed   { 0                                   },
+      pulledSeen{ 0                                   },
+      pulled    { 0                                   },
+      pushedSeen{ 0                                   },
+      region    {                                     },
+      seq       { NIHIL                               },
+      mutex     {                                     },
+      live      {                                     }
+    {}
+
+    Queue( unsigned capacity, bool hugepages = false, const Elem& nihil = Elem{} ) requires( not FIXED ):
+      NIHIL     { nihil                                                       },
+      SPACE     { capacity                                                    },
+      MASK      { std::has_single_bit( capacity ) ? capacity - 1 : 0          },
+      pushed    { 0                                                           },
+      claimed   { 0                                                           },
+      pulledSeen{ 0                                                           },
+      pulled    { 0                                                           },
+      pushedSeen{ 0                                                           },
+      region    ( size_t( capacity )*sizeof( Elem ) + 2*LINE, 0, hugepages    ),
+      seq       { region.template settle< Elem >( capacity, LINE )            },
+      mutex     {                                                             },
+      live      ( capacity                                                    )
+    {
+      static_assert( std::is_trivially_copyable< Elem >::value );
+      assert( capacity > 0 );
+    }
 
     Queue( const Queue& )              = delete;
     Queue& operator = ( const Queue& ) = delete;
 
-    unsigned size()  const { return pushed.load() -  pulled.load(); }
-    bool     empty() const { return pushed.load() == pulled.load(); }
-    Elem     nihil() const { return NIHIL;                          }
+    unsigned capacity() const { // :maximal number of elements
+      if constexpr( FIXED ) return CAPACITY;
+      else                  return SPACE;
+    }
+
+    unsigned size() const {
+      const Unsigned q{ pulled.load( std::memory_order_acquire ) }; // :`pulled` first, so never exceeds `pushed`
+      return unsigned( pushed.load( std::memory_order_acquire ) - q );
+    }
+
+    bool     empty() const { return size() == 0; }
+    Elem     nihil() const { return NIHIL;       }
 
     void clear(){
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      pushed.store( 0 );
-      pulled.store( 0 );
+      Hold hold( mutex, LOCKED );
+      pushed.store( 0, std::memory_order_release );
+      pulled.store( 0, std::memory_order_release );
+      sync();
+      if constexpr( OCCUPANCY ) live.clear();
     }
 
-    bool adjacent( int i, int j ) const {
-      for( int k = i;; ){
-        if( ( ++k ) >= int( CAPACITY ) ) k = 0;
+    std::span< const Elem > raw() const { return std::span< const Elem >( seq, capacity() ); } // :ring buffer as is
+
+    std::pair< Unsigned, Unsigned > counters() const { return { pushed.load(), pulled.load() }; }
+
+    void assign( Unsigned pushedCount, Unsigned pulledCount, std::span< const Elem > ring ){
+                                                                                                                              /*
+      Restore state obtained by `raw()` and `counters()`:
+                                                                                                                              */
+      Hold hold( mutex, LOCKED );
+      assert( ring.size() == capacity()                                          );
+      assert( pulledCount <= pushedCount and pushedCount - pulledCount <= capacity() );
+      std::copy( ring.begin(), ring.end(), seq );
+      pushed.store( pushedCount, std::memory_order_release );
+      pulled.store( pulledCount, std::memory_order_release );
+      sync();
+      survey();
+    }
+
+    unsigned order( unsigned i ) const {
+                                                                                                                              /*
+      Returns logical index (distance from the oldest presented element) of the element
+      stored in `seq[i]`; result >= size() means that `seq[i]` is out of the queue:
+                                                                                                                              */
+      assert( i < capacity() );
+      return slot( Unsigned( i ) + capacity() - slot( pulled.load( std::memory_order_relaxed ) ) );
+    }
+
+    bool adjacent( int64_t i, int64_t j ) const {
+                                                                                                                              /*
+      Check that there are only holes between `seq[i]` and `seq[j]` (`j` follows `i`):
+                                                                                                                              */
+      if constexpr( OCCUPANCY ){
+        const unsigned from( i + 1 == int64_t( capacity() ) ? 0 : i + 1 );
+        if( from <= unsigned( j ) ) return live.none( from, j );
+        return live.none( from, capacity() ) and live.none( 0, j );
+      }
+      for( int64_t k = i;; ){
+        if( ( ++k ) >= int64_t( capacity() ) ) k = 0;
         if( k == j          ) return true;
         if( seq[k] != NIHIL ) return false;
       }
@@ -104,23 +341,22 @@ namespace CoreAGI {
                                                                                                                               */
       unsigned indx{ 0 };
       {
-        if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-        indx = location( pushed, pulled, i );
-        assert( indx >= 0       );
-        assert( indx < CAPACITY );
+        Hold hold( mutex, LOCKED );
+        indx = location( pushed.load( std::memory_order_acquire ), pulled.load( std::memory_order_acquire ), i );
+        assert( indx < capacity() );
       }
       return &seq[ indx ];
     }
 
-    const Elem* operator[] ( int i ) const { return (*this)[ i ]; }
+    const Elem* operator[] ( int i ) const { return const_cast< Queue* >( this )->operator[]( i ); }
 
     Elem& ref( unsigned i ){
-      assert( i < CAPACITY );
+      assert( i < capacity() );
       return seq[ i ];
     }
 
     const Elem& ref( unsigned i ) const {
-      assert( i < CAPACITY );
+      assert( i < capacity() );
       return seq[ i ];
     }
 
@@ -128,83 +364,100 @@ namespace CoreAGI {
                                                                                                                               /*
       Returns last pushed (yungest) element or `NONE` of the sequence is empty:
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed == pulled ) return nullptr;
-      assert( pushed > pulled );
-      return &seq[ ( pushed + CAPACITY - 1 ) % CAPACITY ];
+      Hold hold( mutex, LOCKED );
+      const Unsigned p{ pushed.load( std::memory_order_acquire ) };
+      if( p == pulled.load( std::memory_order_relaxed ) ) return nullptr;
+      return &seq[ slot( p + capacity() - 1 ) ];
     }
 
     Elem* nextToLastRef(){
                                                                                                                               /*
       Returns last pushed (yungest) element or `NONE` of the sequence is empty:
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed == pulled ) return nullptr;
-      assert( pushed > pulled );
-      return &seq[ ( pushed + CAPACITY - 2 ) % CAPACITY ];
+      Hold hold( mutex, LOCKED );
+      const Unsigned p{ pushed.load( std::memory_order_acquire ) };
+      if( p == pulled.load( std::memory_order_relaxed ) ) return nullptr;
+      return &seq[ slot( p + capacity() - 2 ) ];
     }
 
     Elem last() const {
                                                                                                                               /*
       Returns last pushed (yungest) element or `NONE` of the sequence is empty:
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed == pulled ) return NIHIL;
-      assert( pushed > pulled );
-      return seq[ ( pushed + CAPACITY - 1 ) % CAPACITY ];
+      Hold hold( mutex, LOCKED );
+      const Unsigned p{ pushed.load( std::memory_order_acquire ) };
+      if( p == pulled.load( std::memory_order_relaxed ) ) return NIHIL;
+      return seq[ slot( p + capacity() - 1 ) ];
     }
 
     Elem nextToLast() const {
                                                                                                                               /*
       Returns last pushed (yungest) element or `NONE` of the sequence is empty:
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed == pulled ) return NIHIL;
-      assert( pushed > pulled );
-      return seq[ ( pushed + CAPACITY - 2 ) % CAPACITY ];
+      Hold hold( mutex, LOCKED );
+      const Unsigned p{ pushed.load( std::memory_order_acquire ) };
+      if( p == pulled.load( std::memory_order_relaxed ) ) return NIHIL;
+      return seq[ slot( p + capacity() - 2 ) ];
     }
 
-    int lastLoc() const {
+    int64_t lastLoc() const {
                                                                                                                               /*
       Returns index of the last pushed (youngest) element or -1 if the sequence is empty:
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed == pulled ) return -1;
-      assert( pushed > pulled );
-      return ( pushed + CAPACITY - 1 ) % CAPACITY;
+      Hold hold( mutex, LOCKED );
+      const Unsigned p{ pushed.load( std::memory_order_acquire ) };
+      if( p == pulled.load( std::memory_order_relaxed ) ) return -1;
+      return slot( p + capacity() - 1 );
     }
 
     Elem first() const {
                                                                                                                               /*
       Returns oldest element (with logical position 0) or `NIHIL` if the sequence is empty
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed == pulled ) return NIHIL;
-      assert( pushed > pulled );
-      return seq[ pulled % CAPACITY ];
+      Hold hold( mutex, LOCKED );
+      const Unsigned q{ pulled.load( std::memory_order_relaxed ) };
+      if( pushed.load( std::memory_order_acquire ) == q ) return NIHIL;
+      return seq[ slot( q ) ];
     }
 
     Elem pull(){
                                                                                                                               /*
       In case of empty queue returns NIHIL:
                                                                                                                               */
-      if constexpr( NATURE == QueueNature::LOCK_PUSH or NATURE == QueueNature::LOCK_FULL ) Guard lock( mutex );
-      if( empty() ) return NIHIL;
-      const unsigned i{ pulled.load() % CAPACITY };
-      assert( i < CAPACITY );
-      Elem e = seq[i];
-      pulled++; // :atomic
+      Hold hold( mutex, LOCKPULL );
+      if( stock( 1 ) == 0 ) return NIHIL;
+      const Unsigned q{ pulled.load( std::memory_order_relaxed ) };
+      const Elem     e{ seq[ slot( q ) ] };
+      vacate( q, q + 1 );
+      pulled.store( q + 1, std::memory_order_release );
       return e;
     }
 
+    size_t pullN( std::span< Elem > out ){
+                                                                                                                              /*
+      Pull up to `out.size()` oldest elements into `out`; returns number of pulled elements:
+                                                                                                                              */
+      Hold hold( mutex, LOCKPULL );
+      const size_t n{ stock( out.size() ) };
+      if( n == 0 ) return 0;
+      const Unsigned q{ pulled.load( std::memory_order_relaxed ) };
+      get( q, out.data(), n );
+      vacate( q, q + n );
+      pulled.store( q + n, std::memory_order_release );
+      return n;
+    }
+
     Elem pop(){
                                                                                                                               /*
       Removes and returns last pushed (youngest) element; returns NIHIL if sequence is empty:
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      if( pushed <= pulled ) return NIHIL;
-      Elem e{ seq[ ( pushed + CAPACITY - 1 ) % CAPACITY ] };
-      pushed--;
+      Hold hold( mutex, LOCKED );
+      const Unsigned p{ pushed.load( std::memory_order_relaxed ) };
+      if( p <= pulled.load( std::memory_order_relaxed ) ) return NIHIL;
+      Elem e{ seq[ slot( p + capacity() - 1 ) ] };
+      vacate( p - 1, p );
+      pushed.store( p - 1, std::memory_order_release );
+      sync();
       return e;
     }
 
@@ -213,21 +466,44 @@ namespace CoreAGI {
       Returns `false` if pushing will cause overrun.
                                                                                                                               */
       assert( e != NIHIL );
-      if( pushed.load() == LIMIT ){
+      if constexpr( MULTIPUSH ){
+        Unsigned from{ 0 };
+        if( claim( 1, from ) == 0 ) return false;
+        seq[ slot( from ) ] = e;
+        publish( from, 1 );
+      } else {
+        Hold hold( mutex, LOCKPUSH );
+        if( room( 1 ) == 0 ) return false; // :avoid overflow
+        const Unsigned p{ pushed.load( std::memory_order_relaxed ) };
+        seq[ slot( p ) ] = e;
+        occupy( p, p + 1 );
+        pushed.store( p + 1, std::memory_order_release );
+      }
+      return true;
+    }
+
+    size_t pushN( std::span< const Elem > e ){
                                                                                                                               /*
-        Correct counters to avoid overflow:
+      Push as many leading elements of `e` as fit; returns number of pushed elements:
                                                                                                                               */
-        Guard lock( mutex );
-        pushed.store( pushed.load() - LIMIT );
-        pulled.store( pulled.load() - LIMIT );
+      assert( std::find( e.begin(), e.end(), NIHIL ) == e.end() );
+      if constexpr( MULTIPUSH ){
+        Unsigned     from{ 0                      };
+        const size_t n   { claim( e.size(), from ) };
+        if( n == 0 ) return 0;
+        put( from, e.data(), n );
+        publish( from, n );
+        return n;
+      } else {
+        Hold hold( mutex, LOCKPUSH );
+        const size_t n{ room( e.size() ) };
+        if( n == 0 ) return 0;
+        const Unsigned p{ pushed.load( std::memory_order_relaxed ) };
+        put( p, e.data(), n );
+        occupy( p, p + n );
+        pushed.store( p + n, std::memory_order_release );
+        return n;
       }
-      if constexpr( NATURE == QueueNature::LOCK_PULL or NATURE == QueueNature::LOCK_FULL ) Guard lock( mutex );
-      if( pushed.load() >= ( CAPACITY + pulled.load() ) ) return false; // :avoid overflow
-      const unsigned i{ ( pushed.load() + CAPACITY ) % CAPACITY };
-      assert( i < CAPACITY );
-      seq[i] = e;
-      pushed++; // :atomic
-      return true;
     }
 
     std::pair< Elem, Elem > tamp( const Elem& e ){
@@ -237,63 +513,163 @@ namespace CoreAGI {
       nothigh expelled) and logically next element (that still
       be in sequence):
                                                                                                                               */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
+      Hold hold( mutex, LOCKED );
       assert( e != NIHIL );
       std::pair< Elem, Elem > result{ NIHIL, NIHIL }; // :result
-      unsigned SIZE{ size() };
-      assert( SIZE <= CAPACITY );
-      if( SIZE == CAPACITY ){ // Expell oldest element:
-        const unsigned i{ pulled.load() % CAPACITY };
-        assert( i < CAPACITY );
-        result.first = seq[i];
-        pulled++; // :atomic
-        result.second = seq[ pulled % CAPACITY ];
+      const Unsigned p{ pushed.load( std::memory_order_relaxed ) };
+      Unsigned       q{ pulled.load( std::memory_order_relaxed ) };
+      assert( p - q <= capacity() );
+      if( p - q == capacity() ){ // Expell oldest element:
+        result.first  = seq[ slot( q ) ];
+        q++;
+        result.second = seq[ slot( q ) ];
+        pulled.store( q, std::memory_order_release );
       }
-      // push `e`:
-      const unsigned i{ ( pushed.load() + CAPACITY ) % CAPACITY };
-      assert( i < CAPACITY );
-      seq[i] = e;
-      pushed++; // :atomic
+      // push `e` (into the slot of expelled one if any):
+      seq[ slot( p ) ] = e;
+      occupy( p, p + 1 );
+      pushed.store( p + 1, std::memory_order_release );
+      if constexpr( MULTIPUSH ) claimed.store( p + 1, std::memory_order_relaxed );
       return result;
     }
 
-    unsigned compact(){
+    template< typename Location = int32_t > unsigned compact( std::span< std::type_identity_t< Location > > remap = {} ){
                                                                                                                               /*
       Remove all HIHIL elements ( NIHIL can't be inserted, but presented element can be
-      replaced by NIHIL usign access by index); return number of removed empty elements:
-                                                                                                                              */
-      if constexpr( NATURE != QueueNature::LOCK_FREE ) Guard lock( mutex );
-      const unsigned SIZE{ pushed - pulled };
-      if( SIZE == 0 ) return 0;
-      unsigned shift{ 0 };
-      int indx{ 0 };
-      for( unsigned i = 0; i < SIZE; i++ ){
-        indx--;
-        unsigned from = location( pushed, pulled, indx );  assert( from < CAPACITY );
-        if( seq[ from ] == NIHIL ){
-          shift++;
+      replaced by NIHIL usign access by index); return number of removed empty elements.
+      Presented elements are packed toward the newest one: ring is scanned from the newest
+      end as runs of presented elements separated by holes (with OCCUPANCY run boundaries are
+      found by whole bitmap words), and each run is moved by block copy of at most two
+      contiguous segments. If `remap` is given (capacity entries) it receives new location of
+      each presented element at its old location and -1 at old location of each hole; other
+      entries are not touched. `Location` is signed type of `remap` entries:
+                                                                                                                              */
+      Hold hold( mutex, LOCKED );
+      assert( remap.empty() or remap.size() == capacity() );
+      const Unsigned p{ pushed.load( std::memory_order_relaxed ) };
+      const Unsigned q{ pulled.load( std::memory_order_relaxed ) };
+      if( p == q ) return 0;
+      auto hole = [&]( Unsigned c )->bool{
+        if constexpr( OCCUPANCY ) return not live.test( slot( c ) );
+        else                      return seq[ slot( c ) ] == NIHIL;
+      };
+      auto last = [&]( Unsigned c, bool empty )->Unsigned{ // :counter next to the last element in [ q, c ) that is (not) hole, or q
+        if constexpr( OCCUPANCY ){
+          while( c > q ){
+            const Unsigned lap{ std::max( q, c - 1 - slot( c - 1 ) ) }; // :first counter of the segment containing `c - 1`
+            const int64_t  i  { empty ? live.prevZero( slot( c - 1 ) ) : live.prev( slot( c - 1 ) ) };
+            if( i >= slot( lap ) ) return c - ( slot( c - 1 ) - i );
+            c = lap;
+          }
+          return q;
         } else {
-          unsigned into = location( pushed, pulled, indx + shift );  assert( into < CAPACITY );
-          seq[ into ] = seq[ from ];
+          while( c > q and hole( c - 1 ) != empty ) c--;
+          return c;
         }
+      };
+      Unsigned into{ p }; // :elements [ into, p ) are packed
+      for( Unsigned c = p; c > q; ){
+        const Unsigned e{ last( c, false ) }; // :run of presented elements is [ b, e ), holes are [ e, c )
+        if( not remap.empty() ) for( Unsigned h = e; h < c; h++ ) remap[ slot( h ) ] = -1;
+        if( e == q ) break;
+        const Unsigned b{ last( e, true ) };
+        const Unsigned n{ e - b           };
+        into -= n;
+        if( into != b ){
+          for( Unsigned k = n; k > 0; ){ // :copy backward by contiguous segments of source and destination
+            const unsigned s{ slot( b    + k - 1 ) + 1 };
+            const unsigned d{ slot( into + k - 1 ) + 1 };
+            const unsigned m( std::min< Unsigned >( k, std::min( s, d ) ) );
+            std::copy_backward( seq + s - m, seq + s, seq + d );
+            k -= m;
+          }
+        }
+        if( not remap.empty() ) for( Unsigned k = 0; k < n; k++ ) remap[ slot( b + k ) ] = Location( slot( into + k ) );
+        c = b;
       }
-      pulled += shift;
+      const unsigned shift( into - q );
+      pulled.store( into, std::memory_order_release );
+      sync();
+      if constexpr( OCCUPANCY ) if( shift > 0 ) live.assign( slot( into ), p - into == capacity() ? capacity() : slot( p ) );
       return shift;
     }
 
-    bool process( std::function< bool( const Elem& e, Unsigned i ) > f, bool includeHoles = false ) const {
+    void punch( unsigned i ){
+                                                                                                                              /*
+      Replace presented element by hole:
+                                                                                                                              */
+      assert( i < capacity() );
+      seq[i] = NIHIL;
+      if constexpr( OCCUPANCY ) live.reset( i );
+    }
+
+    void move( unsigned from, unsigned into ){
+                                                                                                                              /*
+      Move element into hole at `into`, leaving hole at `from`:
+                                                                                                                              */
+      assert( from < capacity() and into < capacity() and seq[ into ] == NIHIL );
+      seq[ into ] = seq[ from ];
+      seq[ from ] = NIHIL;
+      if constexpr( OCCUPANCY ){
+        live.reset( from );
+        live.set  ( into );
+      }
+    }
+
+    unsigned occupied() const requires( OCCUPANCY ) { return live.count(); } // :number of presented elements
+
+    int64_t following( int64_t i ) const requires( OCCUPANCY ) {
+                                                                                                                              /*
+      Location of the nearest presented element that follows `seq[i]` or -1:
+                                                                                                                              */
+      assert( i >= 0 and i < int64_t( capacity() ) );
+      unsigned k{ live.next( i + 1 ) };
+      if( k >= capacity() ) k = live.next( 0 );
+      if( k >= capacity() ) return -1;
+      return order( k ) > order( i ) ? int64_t( k ) : -1; // :search wrapped around the newest element
+    }
+
+    int64_t preceding( int64_t i ) const requires( OCCUPANCY ) {
+                                                                                                                              /*
+      Location of the nearest presented element that precedes `seq[i]` or -1:
+                                                                                                                              */
+      assert( i >= 0 and i < int64_t( capacity() ) );
+      int64_t k{ live.prev( i - 1 ) };
+      if( k < 0 ) k = live.prev( capacity() - 1 );
+      if( k < 0 ) return -1;
+      return order( k ) < order( i ) ? k : -1; // :search wrapped around the oldest element
+    }
+
+    int64_t at( unsigned k ) const requires( OCCUPANCY ) {
+                                                                                                                              /*
+      Location of the k-th (from the oldest, 0-based) presented element or -1:
+                                                                                                                              */
+      if( k >= live.count() ) return -1;
+      const unsigned head { slot( pulled.load( std::memory_order_relaxed ) ) };
+      const unsigned lower{ live.rank( head )     }; // :presented elements in [ 0, head ), i.e. the newest ones
+      const unsigned upper{ live.count() - lower  }; // :presented elements in [ head, capacity )
+      return k < upper ? live.select( lower + k ) : live.select( k - upper );
+    }
+
+    bool process( std::function< bool( const Elem& e, unsigned i ) > f, bool includeHoles = false ) const {
                                                                                                                               /*
       Call f() for all queue elements sequentially;
       break if f() return `false`;
       returns `true` if all f() calls returned `true`:
                                                                                                                               */
-      Unsigned p = pulled.load();
-      while( p < pushed.load() ){
-        const Unsigned i{ p % CAPACITY };
-        assert( i < CAPACITY );
+      if constexpr( OCCUPANCY ){
+        if( not includeHoles ){
+          const unsigned head{ slot( pulled.load( std::memory_order_relaxed ) ) };
+          for( unsigned i = live.next( head ); i < capacity(); i = live.next( i + 1 ) ) if( not f( seq[i], i ) ) return false;
+          for( unsigned i = live.next( 0 );    i < head;     i = live.next( i + 1 ) ) if( not f( seq[i], i ) ) return false;
+          return true;
+        }
+      }
+      const Unsigned end{ pushed.load( std::memory_order_acquire ) };
+      for( Unsigned p = pulled.load( std::memory_order_acquire ); p < end; p++ ){
+        const unsigned i( slot( p ) );
         const auto e{ seq[i] };
         if( e != NIHIL or includeHoles ) if( not f( e, i ) ) return false;
-        p++;
       }
       return true;
     }
@@ -0,0 +1,378 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Pattern store: atoms and patterns (sequences of atoms) identified by `Identity`,
+ views (pairs of subpatterns that form a pattern) and glossary (pattern sequence ->
+ pattern ID). Both indices are open-addressed tables of 64-bit keys over contiguous
+ memory, so lookup makes no memory allocations and no pointer chasing except the
+ pattern record itself. Records are kept in the `Arena`; pattern is a node that refers
+ to its head and tail subpatterns, so memory per pattern does not depend on its length.
+
+ 2021.03.22
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#ifndef STORE_H_INCLUDED
+#define STORE_H_INCLUDED
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <bit>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+#include "arena.h"
+#include "def.h"
+#include "flat.h"
+
+namespace CoreAGI {
+                                                                                                                              /*
+  Polynomial hash of the sequence of identities modulo Mersenne prime 2^61-1: for sequence a1..an
+  hash = x(a1)*B^(n-1) + .. + x(an), where x() is well mixed image of identity. Hash is order
+  sensitive and composable: signature of concatenation L ++ R is computed from signatures of L and R
+  (hash and B^len) without access to the elements:
+                                                                                                                              */
+  struct Signature {
+
+    static constexpr uint64_t P{ ( uint64_t( 1 ) << 61 ) - 1  }; // :modulus
+    static constexpr uint64_t B{ 0x1F3D5B79A2C4E68Bull % P    }; // :base
+
+    uint64_t hash;  // :[ 0..P-1 ]
+    uint64_t power; // :B^length mod P
+
+    static uint64_t mul( uint64_t a, uint64_t b ){
+      const __uint128_t m{ __uint128_t( a )*b };
+      const uint64_t    r{ ( uint64_t( m ) & P ) + uint64_t( m >> 61 ) };
+      return r >= P ? r - P : r;
+    }
+
+    static uint64_t add( uint64_t a, uint64_t b ){
+      const uint64_t r{ a + b };
+      return r >= P ? r - P : r;
+    }
+
+    static Signature of( const Identity& a ){
+      uint64_t x{ a + 0x9E3779B97F4A7C15ull }; // :splitmix64 finalizer
+      x = ( x ^ ( x >> 30 ) )*0xBF58476D1CE4E5B9ull;
+      x = ( x ^ ( x >> 27 ) )*0x94D049BB133111EBull;
+      x =   x ^ ( x >> 31 );
+      return Signature{ x % P, B };
+    }
+
+    static Signature of( std::span< const Identity > seq ){
+      Signature s{ 0, 1 };
+      for( const Identity& a: seq ) s = s + of( a );
+      return s;
+    }
+
+    Signature operator + ( const Signature& R ) const { return Signature{ add( mul( hash, R.power ), R.hash ), mul( power, R.power ) }; }
+
+    bool operator == ( const Signature& ) const = default;
+
+    uint64_t key() const { return hash + 1; } // :nonzero key for the open-addressed index
+
+  };//struct Signature
+
+  class PatternStore {
+                                                                                                                              /*
+    Open-addressed table: 64-bit key (zero means vacant slot) -> 32-bit value; linear probing,
+    power of two number of slots, initial bucket from high bits of the fibonacci hash of the key.
+    The same key may be presented several times (glossary keeps sequence hashes that may collide),
+    so `find` accepts predicate that selects appropriate value. There are no deletions:
+                                                                                                                              */
+    class Index {
+
+      struct Slot {
+        uint64_t key;
+        uint32_t val;
+      };
+
+      Slot*    slot { nullptr }; // :table
+      unsigned space{ 0       }; // :number of slots, power of two
+      unsigned shift{ 0       }; // :64 - log2( space )
+      unsigned count{ 0       }; // :number of occupied slots
+
+      static constexpr uint64_t PHI{ 0x9E3779B97F4A7C15ull }; // :2^64/golden ratio
+
+      unsigned home( uint64_t key ) const { return unsigned( ( key*PHI ) >> shift ); }
+
+      void allocate( unsigned n ){
+        slot  = static_cast< Slot* >( calloc( n, sizeof( Slot ) ) );
+        space = n;
+        shift = 64 - unsigned( std::countr_zero( n ) );
+        assert( slot );
+      }
+
+      void grow(){
+        Slot*          old{ slot  };
+        const unsigned n  { space };
+        allocate( 2*n );
+        for( unsigned i = 0; i < n; i++ ){
+          if( old[i].key == 0 ) continue;
+          unsigned j{ home( old[i].key ) };
+          while( slot[j].key != 0 ) j = ( j + 1 ) & ( space - 1 );
+          slot[j] = old[i];
+        }
+        free( old );
+      }
+
+    public:
+
+      Index( unsigned capacity ){ allocate( std::bit_ceil( std::max( 2*capacity, 16u ) ) ); }
+
+      Index( const Index& ) = delete;
+      Index& operator = ( const Index& ) = delete;
+
+     ~Index(){ free( slot ); }
+
+      unsigned size() const { return count; }
+
+      template< typename Pred > uint32_t* find( uint64_t key, Pred pred ) const {
+                                                                                                                              /*
+        Returns pointer to the value of first entry with `key` and value that satisfies `pred`, or nullptr:
+                                                                                                                              */
+        assert( key != 0 );
+        for( unsigned i = home( key ); slot[i].key != 0; i = ( i + 1 ) & ( space - 1 ) ){
+          if( slot[i].key == key and pred( slot[i].val ) ) return &slot[i].val;
+        }
+        return nullptr;
+      }
+
+      void incl( uint64_t key, uint32_t val ){
+        assert( key != 0 );
+        if( 2*( count + 1 ) > space ) grow(); // :load factor does not exceed 50%
+        unsigned i{ home( key ) };
+        while( slot[i].key != 0 ) i = ( i + 1 ) & ( space - 1 );
+        slot[i] = Slot{ key, val };
+        count++;
+      }
+
+      template< typename F > void process( F f ) const {
+        for( unsigned i = 0; i < space; i++ ) if( slot[i].key != 0 ) f( slot[i].key, slot[i].val );
+      }
+
+    };//class Index
+                                                                                                                              /*
+    Atom or pattern record. Pattern is kept as a pair of subpatterns it was created of (so all the
+    patterns form a DAG over the atoms) together with its length and signature; sequence of atoms
+    is never materialized except by `unfold`:
+                                                                                                                              */
+    struct Node {
+      Identity  id;
+      Identity  head; // :NIHIL for atom
+      Identity  tail; // :NIHIL for atom
+      unsigned  len;  // :sequence length
+      Signature sig;  // :sequence hash
+    };
+
+    Arena&                                           arena;
+    Flat::Map< Node*, 1024, 80, false, Flat::WIDE >  location; // :Identity -> record in the Arena; any 32-bit ID
+    Index                                            view;     // :combination( head, tail ) -> pattern ID
+    Index                                            glossary; // :signature of pattern sequence -> pattern ID
+    unsigned                                         atoms;    // :number of atoms
+
+    static Key combine( const Identity& head, const Identity& tail ){ return Key( head ) << 32 | tail; }
+
+    const Node* record( const Identity& id ) const {
+      Node* const* n{ location.get( id ) };
+      return n ? *n : nullptr;
+    }
+
+    Identity glossed( unsigned len, const Signature& h ) const {
+                                                                                                                              /*
+      Search pattern with sequence of length `len` and signature `h`. Sequences are not compared:
+      polynomial hash modulo 2^61-1 of two distinct sequences of length n coincide with probability
+      about n/2^61, that is negligible for any feasible number of patterns:
+                                                                                                                              */
+      const uint32_t* i = glossary.find( h.key(), [&]( uint32_t id ){
+        const Node* n{ record( id ) };
+        return n->len == len and n->sig == h;
+      });
+      return i ? Identity( *i ) : NIHIL;
+    }
+
+    void settle( const Node& n ){
+      assert( n.id != NIHIL and not contains( n.id ) );
+      Node* const r{ arena.settle< Node >() };
+      *r = n;
+      location.incl( n.id, r );
+    }
+
+  public:
+
+    PatternStore( Arena& arena, unsigned capacity = 1024 ):
+      arena   { arena    },
+      location{          },
+      view    { capacity },
+      glossary{ capacity },
+      atoms   { 0        }
+    {}
+
+    PatternStore( const PatternStore& ) = delete;
+    PatternStore& operator = ( const PatternStore& ) = delete;
+
+    unsigned patterns() const { return location.size() - atoms; } // :number of patterns excluding atoms
+    unsigned views   () const { return view.size();             } // :number of views
+
+    bool     contains ( const Identity& id ) const { return location.contains( id ); }
+    bool     atomic   ( const Identity& id ) const { const Node* n{ record( id ) }; return n and n->len == 1; }
+    bool     composite( const Identity& id ) const { const Node* n{ record( id ) }; return n and n->len > 1;  }
+
+    unsigned length( const Identity& id ) const {
+      const Node* n{ record( id ) };
+      assert( n );
+      return n->len;
+    }
+                                                                                                                              /*
+    Call f( atom ) for each atom of the pattern sequence in order; DAG is traversed iteratively,
+    so nesting depth is limited by memory only:
+                                                                                                                              */
+    template< typename F > void unfold( const Identity& id, F f ) const {
+      std::vector< const Node* > stack{ record( id ) };
+      while( not stack.empty() ){
+        const Node* n{ stack.back() };
+        stack.pop_back();
+        assert( n );
+        while( n->len > 1 ){
+          stack.push_back( record( n->tail ) );
+          n = record( n->head );
+          assert( n );
+        }
+        f( n->id );
+      }
+    }
+                                                                                                                              /*
+    Register atom:
+                                                                                                                              */
+    void atom( const Identity& id ){
+      settle( Node{ id, NIHIL, NIHIL, 1, Signature::of( id ) } );
+      atoms++;
+    }
+                                                                                                                              /*
+    Pattern presented by view ( head, tail ) or NIHIL:
+                                                                                                                              */
+    Identity known( const Identity& head, const Identity& tail ) const {
+      const uint32_t* i = view.find( combine( head, tail ), []( uint32_t ){ return true; } );
+      return i ? Identity( *i ) : NIHIL;
+    }
+                                                                                                                              /*
+    Pattern with sequence equal to concatenation of sequences of `head` and `tail` or NIHIL:
+                                                                                                                              */
+    Identity search( const Identity& head, const Identity& tail ) const {
+      const Node* H{ record( head ) };
+      const Node* T{ record( tail ) };
+      assert( H and T );
+      return glossed( H->len + T->len, H->sig + T->sig );
+    }
+                                                                                                                              /*
+    Same as `search`, but if found then view ( head, tail ) is registered:
+                                                                                                                              */
+    Identity find( const Identity& head, const Identity& tail ){
+      const Identity id{ search( head, tail ) };
+      if( id != NIHIL ) link( head, tail, id );
+      return id;
+    }
+                                                                                                                              /*
+    Same as `find` but makes new pattern if there is no such one; `generate()` provides candidate ID,
+    candidates that are NIHIL or already in use are skipped:
+                                                                                                                              */
+    template< typename F > Identity make( const Identity& head, const Identity& tail, F generate ){
+      const Node* H{ record( head ) };
+      const Node* T{ record( tail ) };
+      assert( H and T );
+      const unsigned  len{ H->len + T->len };
+      const Signature sig{ H->sig + T->sig };
+      Identity known{ glossed( len, sig ) };
+      if( known == NIHIL ){
+        do known = generate(); while( known == NIHIL or contains( known ) );
+        settle( Node{ known, head, tail, len, sig } );
+        glossary.incl( sig.key(), known );
+      }
+      link( head, tail, known );
+      return known;
+    }
+
+    void link( const Identity& head, const Identity& tail, const Identity& id ){
+      assert( id != NIHIL );
+      const Key key{ combine( head, tail ) };
+      uint32_t* i = view.find( key, []( uint32_t ){ return true; } );
+      if( i ) *i = id; else view.incl( key, id );
+    }
+                                                                                                                              /*
+    Call f( id ) for each pattern (atoms excluded):
+                                                                                                                              */
+    template< typename F > void processPatterns( F f ) const {
+      for( const auto& e: location ) if( e.val->len > 1 ) f( Identity( e.key ) );
+    }
+                                                                                                                              /*
+    Call f( head, tail, id ) for each view:
+                                                                                                                              */
+    template< typename F > void processViews( F f ) const {
+      view.process( [&]( uint64_t key, uint32_t id ){ f( Identity( key >> 32 ), Identity( key ), Identity( id ) ); } );
+    }
+
+  };//class PatternStore
+                                                                                                                              /*
+  Pattern store shared by threads (shards of the `ChronicleEngine`): the same interface as `PatternStore`;
+  lookups take shared lock, operations that register anything take exclusive lock. `find` searches under
+  shared lock and locks exclusively only to register view of the found pattern, so hunting that fails
+  (the most frequent case) does not serialize threads. Callbacks of `unfold`, `process*` and `make` run
+  under the lock and must not call the store:
+                                                                                                                              */
+  class SharedPatternStore {
+
+    using Read  = std::shared_lock< std::shared_mutex >;
+    using Write = std::unique_lock< std::shared_mutex >;
+
+    PatternStore              store;
+    mutable std::shared_mutex mutex;
+
+  public:
+
+    SharedPatternStore( Arena& arena, unsigned capacity = 1024 ): store{ arena, capacity }, mutex{}{}
+
+    SharedPatternStore( const SharedPatternStore& ) = delete;
+    SharedPatternStore& operator = ( const SharedPatternStore& ) = delete;
+
+    unsigned patterns () const                     { Read lock( mutex ); return store.patterns();        }
+    unsigned views    () const                     { Read lock( mutex ); return store.views();           }
+    bool     contains ( const Identity& id ) const { Read lock( mutex ); return store.contains( id );    }
+    bool     atomic   ( const Identity& id ) const { Read lock( mutex ); return store.atomic( id );      }
+    bool     composite( const Identity& id ) const { Read lock( mutex ); return store.composite( id );   }
+    unsigned length   ( const Identity& id ) const { Read lock( mutex ); return store.length( id );      }
+
+    template< typename F > void unfold( const Identity& id, F f ) const { Read lock( mutex ); store.unfold( id, f ); }
+
+    void atom( const Identity& id ){ Write lock( mutex ); store.atom( id ); }
+
+    Identity known ( const Identity& head, const Identity& tail ) const { Read lock( mutex ); return store.known( head, tail );  }
+    Identity search( const Identity& head, const Identity& tail ) const { Read lock( mutex ); return store.search( head, tail ); }
+
+    Identity find( const Identity& head, const Identity& tail ){
+      const Identity id{ search( head, tail ) };
+      if( id != NIHIL ) link( head, tail, id );
+      return id;
+    }
+
+    template< typename F > Identity make( const Identity& head, const Identity& tail, F generate ){
+      Write lock( mutex );
+      return store.make( head, tail, generate );
+    }
+
+    void link( const Identity& head, const Identity& tail, const Identity& id ){ Write lock( mutex ); store.link( head, tail, id ); }
+
+    template< typename F > void processPatterns( F f ) const { Read lock( mutex ); store.processPatterns( f ); }
+    template< typename F > void processViews   ( F f ) const { Read lock( mutex ); store.processViews( f );    }
+
+  };//class SharedPatternStore
+
+}//namespace CoreAGI
+
+#endif // STORE_H_INCLUDED
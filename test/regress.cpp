@@ -0,0 +1,434 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Regression cases; each case prints its name and OK or FAILED, exit code is
+ the number of failed cases.
+
+ USAGE
+
+   ./test.sh
+
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#include <cassert>
+#include <cstdio>
+
+#include <atomic>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../arena.h"
+#include "../chronicle.h"
+#include "../codec.h"
+#include "../def.h"
+#include "../engine.h"
+#include "../flat.h"
+#include "../pipeline.h"
+#include "../queue.h"
+#include "../store.h"
+
+using namespace CoreAGI;
+
+namespace {
+                                                                                                                              /*
+  Atoms 1..127 and patterns in the store (`PatternStore` or `SharedPatternStore`); hooks mimic the
+  driver (space and dot are unconnectable):
+                                                                                                                              */
+  template< typename Store = PatternStore > struct Vocabulary {
+
+    Arena    arena{ 64*1024 };
+    Store    store{ arena   };
+    Identity fresh{ 1000    }; // :IDs of patterns; `make` calls generator under the lock of shared store
+
+    Vocabulary(){ for( unsigned c = 1; c < 128; c++ ) store.atom( c ); }
+
+    auto hooks(){
+      return Hooks{
+        [this]( const Identity& id ){ std::string s; store.unfold( id, [&]( const Identity& a ){ s += char( a ); } ); return s; },
+        []( const Identity& head, const Identity& tail ){
+          auto unconnectable = []( const Identity& id ){ return id == Identity( ' ' ) or id == Identity( '.' ); };
+          return not unconnectable( head ) and not ( unconnectable( tail ) and head < 128 );
+        },
+        [this]( const Identity& head, const Identity& tail ){ return store.make( head, tail, [&]{ return fresh++; } ); },
+        [this]( const Identity& head, const Identity& tail ){ return store.known( head, tail ); }
+      };
+    }
+
+  };//struct Vocabulary
+                                                                                                                              /*
+  Include `input` and check that chronicle is consistent and its content unfolds to the input:
+                                                                                                                              */
+  template< typename C, typename H > bool replay( C& chronicle, const H& hooks, const std::string& input ){
+    for( const char c: input ) if( not chronicle.incl( Identity( c ) ) ) return false;
+    std::string unfolded;
+    chronicle.process( [&]( const auto& e, unsigned )->bool{ unfolded += hooks.lex( e.id ); return true; } );
+    return chronicle.consistent() and unfolded == input;
+  }
+
+  std::string repeated( unsigned times ){
+    std::string input;
+    for( unsigned i = 0; i < times; i++ ) input += "the quick brown fox jumps over the lazy dog. ";
+    return input;
+  }
+                                                                                                                              /*
+  Repetitive input folds the window down to repeats of single ID, so identical pair is made
+  while sequence holds one distinct ID; content must still unfold to the input:
+                                                                                                                              */
+  bool repetitiveInput(){
+    Vocabulary vocabulary;
+    auto       hooks{ vocabulary.hooks() };
+    Chronicle< 16*1024, decltype( hooks ) > chronicle( hooks );
+    return replay( chronicle, hooks, repeated( 200 ) );
+  }
+                                                                                                                              /*
+  Resident memory in bytes:
+                                                                                                                              */
+  size_t resident(){
+    size_t pages{ 0 }, rss{ 0 };
+    FILE* statm = fopen( "/proc/self/statm", "r" );
+    if( statm ){ if( fscanf( statm, "%zu %zu", &pages, &rss ) != 2 ) rss = 0; fclose( statm ); }
+    return rss*size_t( sysconf( _SC_PAGESIZE ) );
+  }
+                                                                                                                              /*
+  Reset of large run-time capacity chronicle does not touch pages of arrays indexed by location,
+  and the chronicle works after reset as a new one:
+                                                                                                                              */
+  bool lazyReset(){
+    constexpr unsigned CAPACITY{ 8 << 20 };
+    Vocabulary vocabulary;
+    auto       hooks{ vocabulary.hooks() };
+    Chronicle< DYNAMIC, decltype( hooks ) > chronicle( hooks, CAPACITY );
+    if( not replay( chronicle, hooks, repeated( 100 ) ) ) return false;
+    const size_t before{ resident() };
+    chronicle.reset();
+    const size_t after{ resident() };
+    return after < before + CAPACITY and chronicle.empty() and replay( chronicle, hooks, repeated( 100 ) ); // :touching all nodes takes CAPACITY*sizeof( Pair )
+  }
+
+                                                                                                                              /*
+  Empty batches (e.g. block of input normalized to nothing) do not end the stream: consumer gets
+  all the batches, so producer is never left waiting on the full ring:
+                                                                                                                              */
+  bool emptyBatches(){
+    constexpr unsigned BATCHES{ 1000 };
+    Pipeline< unsigned, 16, 4 > pipe;
+    std::thread producer( [&]{
+      for( unsigned i = 0; i < BATCHES; i++ ){
+        const size_t n{ i % 3 == 0 ? 0 : 1 + i % 16 };
+        std::span< unsigned > slot{ pipe.acquire() };
+        for( size_t k = 0; k < n; k++ ) slot[k] = i;
+        pipe.publish( n );
+      }
+      pipe.close();
+    });
+    unsigned batches{ 0 };
+    bool     ordered{ true };
+    for( std::span< const unsigned > batch; pipe.next( batch ); ){
+      for( const unsigned i: batch ) ordered = ordered and i == batches;
+      batches++;
+      pipe.release();
+    }
+    producer.join();
+    return ordered and batches == BATCHES and pipe.batches() == BATCHES;
+  }
+
+                                                                                                                              /*
+  MPSC producers race for the last slots of nearly full ring; every element must be pulled once
+  and elements of each producer in the order they were pushed:
+                                                                                                                              */
+  bool crowdedProducers(){
+    constexpr unsigned CAP     { 16    };
+    constexpr unsigned PRODUCERS{ 4     };
+    constexpr unsigned COUNT   { 50000 }; // :elements per producer
+    Queue< Identity, CAP, QueueNature::MPSC > queue;
+    std::atomic< unsigned >    done{ 0 };
+    std::vector< std::thread > producers;
+    for( unsigned p = 0; p < PRODUCERS; p++ ){
+      producers.emplace_back( [&, p]{
+        Identity e[ 5 ];
+        for( unsigned i = 0; i < COUNT; ){
+          const unsigned n{ std::min( 1 + i % 5, COUNT - i ) };
+          for( unsigned k = 0; k < n; k++ ) e[k] = ( p + 1 ) << 24 | ( i + k + 1 );
+          const size_t pushed{ n == 1 ? size_t( queue.push( e[0] ) ) : queue.pushN( std::span< const Identity >( e, n ) ) };
+          if( pushed == 0 ) std::this_thread::yield();
+          i += unsigned( pushed );
+        }
+        done++;
+      });
+    }
+    std::vector< unsigned > next( PRODUCERS, 1 ); // :expected sequence number
+    bool     ordered{ true };
+    unsigned pulled { 0    };
+    Identity out[ 3 ];
+    while( pulled < PRODUCERS*COUNT ){
+      if( queue.size() + 2 < CAP and done < PRODUCERS ){ std::this_thread::yield(); continue; } // :keep ring nearly full
+      const size_t n{ queue.pullN( std::span< Identity >( out, 3 ) ) };
+      for( size_t k = 0; k < n; k++ ){
+        const unsigned p{ ( out[k] >> 24 ) - 1 };
+        ordered = ordered and p < PRODUCERS and ( out[k] & 0xFFFFFF ) == next[p]++;
+      }
+      pulled += unsigned( n );
+    }
+    for( auto& t: producers ) t.join();
+    return ordered and queue.empty();
+  }
+
+                                                                                                                              /*
+  Set filled up to its capacity with random keys (long clusters, large DIB) and thinned out by
+  exclusions keeps every key: insertion never rebuilds the table:
+                                                                                                                              */
+  bool fullSet(){
+    constexpr unsigned CAPACITY{ 1000 };
+    Flat::Set< CAPACITY >     set;
+    std::set< Flat::Elem >    model;
+    std::mt19937              random{ 2021 };
+    std::vector< Flat::Elem > keys;
+    while( keys.size() < CAPACITY ){
+      const Flat::Elem key{ 1 + Flat::Elem( random() % ( Flat::UINT24 - 1 ) ) };
+      if( model.insert( key ).second ) keys.push_back( key );
+    }
+    bool ok{ true };
+    for( unsigned round = 0; round < 20; round++ ){
+      for( const Flat::Elem key: keys ) if( not set.contains( key ) ) ok = ok and set.incl( key ) == Flat::Set< CAPACITY >::INCLUDED;
+      ok = ok and set.size() == CAPACITY and set.incl( Flat::UINT24 - 1 ) == Flat::Set< CAPACITY >::EXHAUSTED;
+      for( const Flat::Elem key: keys ) ok = ok and set.contains( key );
+      for( unsigned i = round % 3; i < CAPACITY; i += 3 ) ok = ok and set.excl( keys[i] ) == Flat::Set< CAPACITY >::EXCLUDED;
+      for( unsigned i = 0; i < CAPACITY; i++ ) ok = ok and set.contains( keys[i] ) == ( i % 3 != round % 3 );
+    }
+    return ok;
+  }
+
+                                                                                                                              /*
+  Growing map migrates at most MIGRATION slots of the previous array per incl/excl (excl may also
+  remove one not migrated entry), growth never waits for migration, content is kept:
+                                                                                                                              */
+  bool gradualMigration(){
+    using Map = Flat::Map< unsigned, 16 >;
+    Map                                      map;
+    std::unordered_map< unsigned, unsigned > model;
+    std::mt19937                             random{ 2021 };
+    bool                                     ok{ true };
+    for( unsigned i = 0; i < 200000 and ok; i++ ){
+      const unsigned key     { 1 + unsigned( random() % 100000 ) };
+      const unsigned pending { map.migrating() };
+      const unsigned capacity{ map.capacity()  };
+      if( random() % 3 ){ map.incl( key, i ); model[ key ] = i; } else { map.excl( key ); model.erase( key ); }
+      ok = ok and pending <= map.migrating() + Map::MIGRATION + 1;
+      if( map.capacity() != capacity ) ok = ok and pending <= Map::MIGRATION;
+      ok = ok and map.size() == model.size();
+    }
+    for( const auto& [ key, val ]: model ){ const unsigned* v{ map.get( key ) }; ok = ok and v and *v == val; }
+    unsigned n{ 0 };
+    for( const auto& e: map ){ n++; ok = ok and model.contains( e.key ) and model.at( e.key ) == e.val; }
+    return ok and n == model.size();
+  }
+
+                                                                                                                              /*
+  Map built in bulk holds the same content as map filled key by key; batch lookup agrees with `get`
+  for presented and missing keys; built map keeps growing by regular `incl`:
+                                                                                                                              */
+  bool bulkMap(){
+    using Map = Flat::Map< unsigned, 16, 80, false, Flat::WIDE >;
+    Map                                             built;
+    Map                                             filled;
+    std::mt19937                                    random{ 2021 };
+    std::vector< std::pair< Flat::Key, unsigned > > items;
+    std::unordered_map< Flat::Key, unsigned >       model;
+    while( items.size() < 50000 ){
+      const Flat::Key key{ 1 + Flat::Key( random() % 0xFFFFFFFEu ) };
+      if( model.contains( key ) ) continue;
+      model[ key ] = unsigned( items.size() );
+      items.emplace_back( key, unsigned( items.size() ) );
+    }
+    built.incl( 1, 1 ); // :replaced by `build`
+    built.build( items );
+    for( const auto& [ key, val ]: items ) filled.incl( key, val );
+    bool ok{ built.size() == items.size() and filled.size() == items.size() and built.contains( 1 ) == model.contains( 1 ) };
+    std::vector< Flat::Key > keys;
+    for( unsigned i = 0; i < items.size(); i++ ){
+      keys.push_back( items[i].first );
+      keys.push_back( items[i].first ^ 0x5A5A5A5Au ); // :most likely missing
+    }
+    std::vector< unsigned* > found( keys.size() );
+    built.getBatch( keys, found );
+    for( unsigned i = 0; i < keys.size(); i++ ){
+      const unsigned* b{ built.get( keys[i] ) };
+      const unsigned* f{ filled.get( keys[i] ) };
+      ok = ok and found[i] == b and ( b == nullptr ) == ( f == nullptr ) and ( b == nullptr or *b == *f );
+    }
+    for( unsigned i = 0; i < 100000; i++ ){
+      const Flat::Key key{ 1 + Flat::Key( random() % 0xFFFFFFFEu ) };
+      built.incl( key, i );
+      model[ key ] = i;
+    }
+    for( const auto& [ key, val ]: model ){ const unsigned* v{ built.get( key ) }; ok = ok and v and *v == val; }
+    return ok and built.size() == model.size();
+  }
+
+                                                                                                                              /*
+  Batch text decoder stops at token that does not represent Identity (six symbols with value above
+  32 bits or invalid symbol) both in the word-at-once path and near the end of text, and reports
+  position of the token by `consumed`; the largest six symbol token is decoded:
+                                                                                                                              */
+  bool invalidTokens(){
+    auto check = []( const std::string& text, std::vector< Identity > expected, size_t at ){
+      std::vector< Identity > ids( 16 );
+      size_t consumed{ 0 };
+      ids.resize( decode( text, ids, &consumed ) );
+      return ids == expected and consumed == at;
+    };
+    const std::string tail( 12, ' ' ); // :whole words are available
+    return check( "a 3$$$$$" + tail,          { 10, 0xFFFFFFFFu }, 8 + tail.size() )
+       and check( "a 3$$$$$",                 { 10, 0xFFFFFFFFu }, 8               )
+       and check( "a 400000 b" + tail,        { 10              }, 2               )
+       and check( "a 400000",                 { 10              }, 2               )
+       and check( "a zzzzzz b" + tail,        { 10              }, 2               )
+       and check( "a 1234567 b" + tail,       { 10              }, 2               )
+       and check( "a b#c d" + tail,           { 10              }, 2               )
+       and check( "a b#",                     { 10              }, 2               );
+  }
+
+                                                                                                                              /*
+  Saved sequence is loaded back; truncated binary file and text file with invalid token are
+  rejected before anything is included:
+                                                                                                                              */
+  bool truncatedFile(){
+    Vocabulary vocabulary;
+    auto       hooks{ vocabulary.hooks() };
+    Chronicle< 16*1024, decltype( hooks ) > chronicle( hooks );
+    Chronicle< 16*1024, decltype( hooks ) > loaded   ( hooks );
+    std::mt19937 random{ 2021 };
+    std::string  input;
+    const char*  WORD[]{ "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog. " };
+    while( input.size() < 4000 ) input += WORD[ random() % 8 ];
+    if( not replay( chronicle, hooks, input ) ) return false;
+    char path[]{ "/tmp/regressXXXXXX" };
+    const int fd{ mkstemp( path ) };
+    if( fd < 0 ) return false;
+    close( fd );
+    auto exist = [&]( Identity id ){ return vocabulary.store.contains( id ); };
+    auto bytes = [&]{
+      std::vector< char > data;
+      FILE* src = fopen( path, "rb" );
+      for( int c; src and ( c = fgetc( src ) ) >= 0; ) data.push_back( char( c ) );
+      if( src ) fclose( src );
+      return data;
+    };
+    auto rewrite = [&]( const std::vector< char >& data ){
+      FILE* out = fopen( path, "wb" );
+      fwrite( data.data(), 1, data.size(), out );
+      fclose( out );
+    };
+    bool ok{ chronicle.save( path, decltype( chronicle )::Format::BINARY ) and loaded.load( path, exist ) == 0 };
+    ok = ok and loaded.len() == chronicle.len();
+    loaded.reset();
+    std::vector< char > data{ bytes() };
+    while( not data.empty() and not ( data.back() & 0x80 ) ) data.pop_back(); // :cut inside multi-byte varint
+    rewrite( data );
+    ok = ok and data.size() > 64 and loaded.load( path, exist ) == -3 and loaded.empty();
+    ok = ok and chronicle.save( path ) and loaded.load( path, exist ) == 0 and loaded.len() == chronicle.len();
+    loaded.reset();
+    data = bytes();
+    for( const char c: std::string( " 4zzzzz" ) ) data.push_back( c ); // :exceeds 32 bits
+    rewrite( data );
+    ok = ok and loaded.load( path, exist ) == -3 and loaded.empty();
+    unlink( path );
+    return ok;
+  }
+
+                                                                                                                              /*
+  Documents processed by shards of `ChronicleEngine` over shared store: each shard holds its own
+  document, patterns made by one shard are used by the others, and totals agree with single
+  chronicle that processes all the documents:
+                                                                                                                              */
+  bool sharedShards(){
+    constexpr unsigned SHARDS  { 3         };
+    constexpr unsigned CAPACITY{ 64*1024   };
+    constexpr size_t   LENGTH  { 20000     }; // :document length
+    constexpr size_t   BATCH   { 1000      };
+    std::mt19937               random{ 2021 };
+    std::vector< std::string > document( SHARDS );
+    const char*                WORD[]{ "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog. " };
+    for( auto& d: document ){ while( d.size() < LENGTH ) d += WORD[ random() % 8 ]; d.resize( LENGTH ); }
+    auto run = []( auto& chronicle, std::span< const Identity > batch ){
+      chronicle.incl( batch );
+      if( chronicle.gap() >= 256 ) chronicle.compact();
+    };
+    auto content = []( const auto& chronicle, const auto& hooks ){
+      std::string s;
+      chronicle.process( [&]( const auto& e, unsigned )->bool{ s += hooks.lex( e.id ); return true; } );
+      return s;
+    };
+    Vocabulary single;
+    auto       alone{ single.hooks() };
+    Chronicle< DYNAMIC, decltype( alone ) > whole( alone, CAPACITY );
+    for( const auto& d: document ){
+      const std::vector< Identity > ids( d.begin(), d.end() );
+      run( whole, ids );
+    }
+    Vocabulary< SharedPatternStore > shared;
+    auto                             hooks{ shared.hooks() };
+    using Engine = ChronicleEngine< DYNAMIC, decltype( hooks ) >;
+    Engine engine( SHARDS, hooks, [&]( unsigned, Engine::Shard& shard, std::span< const Identity > batch ){ run( shard, batch ); },
+                   SHARDS, 4, CAPACITY );
+    for( size_t at = 0; at < LENGTH; at += BATCH ){ // :shards progress together
+      for( unsigned k = 0; k < SHARDS; k++ ){
+        const auto begin{ document[k].begin() + std::min( at, document[k].size() ) };
+        const auto end  { document[k].begin() + std::min( at + BATCH, document[k].size() ) };
+        engine.feed( k, Engine::Batch( begin, end ) );
+      }
+    }
+    engine.wait();
+    bool                                ok{ whole.consistent() };
+    uint64_t                            symbols{ 0 };
+    std::string                         all;
+    std::vector< std::set< Identity > > used( SHARDS ); // :patterns in the sequence of each shard
+    for( unsigned k = 0; k < SHARDS; k++ ){
+      const auto& shard{ engine.shard( k ) };
+      ok = ok and shard.consistent() and content( shard, hooks ) == document[k] and engine.symbols( k ) == document[k].size();
+      shard.process( [&]( const auto& e, unsigned )->bool{ if( e.id >= 1000 ) used[k].insert( e.id ); return true; } );
+      symbols += engine.symbols( k );
+      all     += document[k];
+    }
+    for( unsigned k = 0; k < SHARDS; k++ ){ // :some pattern of each shard is used by another one
+      bool reused{ false };
+      for( const Identity id: used[k] ) for( unsigned j = 0; j < SHARDS; j++ ) reused = reused or ( j != k and used[j].contains( id ) );
+      ok = ok and reused;
+    }
+    return ok and symbols == all.size() and content( whole, alone ) == all and shared.store.patterns() > 0
+              and shared.store.patterns() < SHARDS*single.store.patterns();
+  }
+
+}//namespace
+
+int main(){
+  struct Case { const char* name; bool (*run)(); };
+  const std::vector< Case > cases{
+    { "repetitive input",       repetitiveInput },
+    { "empty pipeline batches", emptyBatches    },
+    { "crowded MPSC producers", crowdedProducers },
+    { "lazy reset",             lazyReset        },
+    { "full set",               fullSet          },
+    { "gradual map migration",  gradualMigration },
+    { "bulk map build",         bulkMap          },
+    { "invalid text tokens",    invalidTokens    },
+    { "truncated file",         truncatedFile    },
+    { "shards over shared store", sharedShards   },
+  };
+  int failed{ 0 };
+  for( const Case& c: cases ){
+    const bool ok{ c.run() };
+    printf( " %-32s %s\n", c.name, ok ? "OK" : "FAILED" );
+    if( not ok ) failed++;
+  }
+  return failed;
+}
@@ -0,0 +1,3 @@
+#!/bin/bash
+cd "$( dirname "$0" )"
+g++ -std=c++20 -m64 -pthread -O2 regress.cpp -o regress && ./regress
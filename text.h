@@ -0,0 +1,91 @@
+                                                                                                                              /*
+ Copyright Mykola Rabchevskiy 2021.
+ Distributed under the Boost Software License, Version 1.0.
+ (See http://www.boost.org/LICENSE_1_0.txt)
+ ______________________________________________________________________________
+
+ Text normalization for the `Chronicle` input: CR removed, control and non-ASCII
+ symbols replaced by space, multiple spaces collapsed, letters converted to
+ lower case. Blocks of 16 bytes without CR are processed by SSE2 instructions;
+ blocks that contain CR and the tail of the buffer are processed symbol by symbol.
+
+ 2021.03.10
+________________________________________________________________________________________________________________________________
+                                                                                                                              */
+#ifndef TEXT_H_INCLUDED
+#define TEXT_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined( __SSE2__ )
+  #include <emmintrin.h>
+#endif
+
+namespace CoreAGI::Text {
+
+  constexpr char CR { '\r' };
+  constexpr char SPC{ ' '  };
+
+  inline char normal( char c ){ // :symbol normalization except CR removal
+    if( c >= 127 or c < 32 ) return SPC;
+    return ( c >= 'A' and c <= 'Z' ) ? char( c + 'a' - 'A' ) : c;
+  }
+
+  inline size_t normalize( const char* src, size_t n, char* dst, char& prev ){
+                                                                                                                              /*
+    Normalize `n` bytes of `src` into `dst` (at least `n` bytes); `prev` is the last symbol
+    written by previous call (SPC initially) and is updated. Returns number of written symbols:
+                                                                                                                              */
+    size_t m{ 0 };
+    auto scalar = [&]( size_t from, size_t to ){
+      for( size_t i = from; i < to; i++ ){
+        if( src[i] == CR ) continue;
+        const char c{ normal( src[i] ) };
+        if( c == SPC and prev == SPC ) continue; // :eliminate multiple spaces
+        dst[ m++ ] = prev = c;
+      }
+    };
+    size_t i{ 0 };
+#if defined( __SSE2__ )
+    const __m128i CR16 { _mm_set1_epi8( CR        ) };
+    const __m128i SPC16{ _mm_set1_epi8( SPC       ) };
+    const __m128i LO   { _mm_set1_epi8( 31        ) };
+    const __m128i HI   { _mm_set1_epi8( 127       ) };
+    const __m128i A    { _mm_set1_epi8( 'A' - 1   ) };
+    const __m128i Z    { _mm_set1_epi8( 'Z' + 1   ) };
+    const __m128i CASE { _mm_set1_epi8( 'a' - 'A' ) };
+    for( ; i + 16 <= n; i += 16 ){
+      const __m128i v{ _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + i ) ) };
+      if( _mm_movemask_epi8( _mm_cmpeq_epi8( v, CR16 ) ) ){ scalar( i, i + 16 ); continue; }
+                                                                                                                              /*
+      Bytes >= 128 are negative as signed, so they fail `> 31` test and become spaces too:
+                                                                                                                              */
+      const __m128i printable{ _mm_and_si128( _mm_cmpgt_epi8( v, LO ), _mm_cmplt_epi8( v, HI ) ) };
+      __m128i w{ _mm_or_si128( _mm_and_si128( printable, v ), _mm_andnot_si128( printable, SPC16 ) ) };
+      const __m128i upper{ _mm_and_si128( _mm_cmpgt_epi8( w, A ), _mm_cmplt_epi8( w, Z ) ) };
+      w = _mm_add_epi8( w, _mm_and_si128( upper, CASE ) );
+                                                                                                                              /*
+      Without CR every symbol is kept except space that follows space:
+                                                                                                                              */
+      const __m128i space{ _mm_cmpeq_epi8( w, SPC16 ) };
+      const __m128i after{ _mm_or_si128( _mm_slli_si128( space, 1 ), _mm_cvtsi32_si128( prev == SPC ? 0xFF : 0 ) ) };
+      const unsigned drop{ unsigned( _mm_movemask_epi8( _mm_and_si128( space, after ) ) ) };
+      if( drop == 0 ){
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( dst + m ), w ); // :m <= i, so it fits
+        m += 16;
+      } else {
+        alignas( 16 ) char buf[ 16 ];
+        _mm_store_si128( reinterpret_cast< __m128i* >( buf ), w );
+        for( unsigned k = 0; k < 16; k++ ) if( not ( drop >> k & 1 ) ) dst[ m++ ] = buf[k];
+      }
+      prev = char( _mm_extract_epi16( w, 7 ) >> 8 );
+    }
+#endif
+    scalar( i, n );
+    return m;
+  }
+
+}//namespace CoreAGI::Text
+
+#endif // TEXT_H_INCLUDED